@@ -0,0 +1,919 @@
+// Benchmark is for Windows Console, and it measures throughput and latency of
+// NTRINGB ring-buffers, and of NTARC atomic load and store.
+//
+// Each thread is pinned to its own CPU, and all threads start together once
+// all of them are ready. Results are printed to standard output as CSV, one
+// row per run, so that they can be collected and compared across versions:
+//
+//   lock-free-benchmark.exe [operation_count] > results.csv
+//
+// Each row tells width of NTRINGB positions the benchmark was built with. Build
+// it also with NTRINGB_SEQ64 defined to compare 64-bit positions against 32-bit
+// positions, e.g. into lock-free-benchmark-seq64.exe:
+//
+//   msbuild lock-free-benchmark.vcxproj /p:Configuration=Release /p:Platform=x64 /p:NtringbSeq64=true
+//
+#define MEAN_AND_LEAN
+#include <Windows.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+// Header only
+#include "ntringb.h"
+#include "ntarc.h"
+
+#define BENCH_MAX_THREAD_COUNT 16
+#define BENCH_MAX_BUFFER_COUNT 65536
+#define BENCH_DEFAULT_OPERATION_COUNT 4000000
+#define BENCH_LATENCY_SAMPLE_COUNT 100000
+#define BENCH_LATENCY_BUFFER_COUNT 1024
+
+// Width of NTRINGB positions in bits
+#define BENCH_SEQ_BITS ((int)(sizeof(NTRINGB_SEQ) * 8))
+
+/// <summary>
+/// Benchmark thread data structure
+///
+/// Note: checksum of consumed values is kept, so that compiler cannot
+/// optimize away the reads, and also to verify that nothing was lost.
+/// </summary>
+typedef struct tagBENCH_THREAD {
+	HANDLE handle;
+	LONG index;
+	LONG cpu;
+	LONG operation_count;
+	LONG64 checksum;
+} BENCH_THREAD, *PBENCH_THREAD;
+
+typedef DWORD (WINAPI *PFN_BENCH_THREAD)(LPVOID);
+
+LONG g_cpu_count;
+double g_ticks_per_ns;
+
+LONG volatile g_ready;
+LONG volatile g_start;
+LONG volatile g_stop;
+
+volatile NTRINGB g_ringb;
+volatile NTRINGB g_ringb_pong;
+volatile NTRINGB_SPSC g_spsc;
+volatile NTRINGB_SPSC g_spsc_pong;
+NTRINGB_LANES g_lanes;
+NTRINGB_LANE volatile g_lane_array[BENCH_MAX_THREAD_COUNT];
+LONG64 volatile g_lane_buffer[BENCH_MAX_THREAD_COUNT * BENCH_MAX_BUFFER_COUNT];
+volatile NTRINGB_MPMC g_mpmc;
+NTRINGB_SEQ volatile g_mpmc_sequence[BENCH_MAX_BUFFER_COUNT];
+LONG64 volatile g_buffer[BENCH_MAX_BUFFER_COUNT];
+LONG64 volatile g_buffer_pong[BENCH_MAX_BUFFER_COUNT];
+LONG64 g_latency[BENCH_LATENCY_SAMPLE_COUNT];
+
+volatile NTARC g_arc = { 0, 0 };
+NTARC g_arc_values[2];
+NTARC_CONTROL_BLOCK g_arc_control_blocks[2];
+LONG64 g_arc_data[2] = { 1, 2 };
+
+/// <summary>
+/// Pin calling thread to its CPU, and wait until all threads are ready
+/// </summary>
+/// <param name="p_thread">A pointer to benchmark thread</param>
+void bench_thread_enter(PBENCH_THREAD p_thread) {
+	SetThreadAffinityMask(GetCurrentThread(), (DWORD_PTR)1 << p_thread->cpu);
+
+	InterlockedIncrement(&g_ready);
+
+	while (0 == g_start)
+	{
+		YieldProcessor();
+	}
+}
+
+/// <summary>
+/// Run benchmark threads, and measure time until first measured_count threads finish
+///
+/// Note: remaining threads are background threads, which run until g_stop is set.
+/// </summary>
+/// <param name="p_routines">An array of thread routines</param>
+/// <param name="p_threads">An array of benchmark threads</param>
+/// <param name="thread_count">Count of threads</param>
+/// <param name="measured_count">Count of threads to wait for before stopping the clock</param>
+/// <returns>Elapsed time in seconds</returns>
+double bench_run(PFN_BENCH_THREAD *p_routines, PBENCH_THREAD p_threads, LONG thread_count, LONG measured_count) {
+	LARGE_INTEGER frequency;
+	LARGE_INTEGER start;
+	LARGE_INTEGER end;
+	LONG i;
+
+	g_ready = 0;
+	g_start = 0;
+	g_stop = 0;
+
+	for (i = 0; i != thread_count; ++i)
+	{
+		p_threads[i].index = i;
+		p_threads[i].cpu = i % g_cpu_count;
+		p_threads[i].checksum = 0;
+		p_threads[i].handle = CreateThread(NULL, 0, p_routines[i], &p_threads[i], 0, NULL);
+	}
+
+	while (thread_count != g_ready)
+	{
+		Sleep(1);
+	}
+
+	QueryPerformanceFrequency(&frequency);
+	QueryPerformanceCounter(&start);
+	InterlockedExchange(&g_start, 1);
+
+	for (i = 0; i != measured_count; ++i)
+	{
+		WaitForSingleObject(p_threads[i].handle, INFINITE);
+	}
+
+	QueryPerformanceCounter(&end);
+	InterlockedExchange(&g_stop, 1);
+
+	for (i = 0; i != thread_count; ++i)
+	{
+		if (i >= measured_count)
+		{
+			WaitForSingleObject(p_threads[i].handle, INFINITE);
+		}
+
+		CloseHandle(p_threads[i].handle);
+	}
+
+	return (double)(end.QuadPart - start.QuadPart) / (double)frequency.QuadPart;
+}
+
+/// <summary>
+/// Measure how many time-stamp counter ticks are there per nanosecond
+/// </summary>
+void bench_calibrate(void) {
+	LARGE_INTEGER frequency;
+	LARGE_INTEGER start;
+	LARGE_INTEGER end;
+	LONG64 start_ticks;
+	LONG64 end_ticks;
+
+	QueryPerformanceFrequency(&frequency);
+	QueryPerformanceCounter(&start);
+	start_ticks = (LONG64)ReadTimeStampCounter();
+
+	Sleep(100);
+
+	QueryPerformanceCounter(&end);
+	end_ticks = (LONG64)ReadTimeStampCounter();
+
+	g_ticks_per_ns = (double)(end_ticks - start_ticks) * (double)frequency.QuadPart
+		/ ((double)(end.QuadPart - start.QuadPart) * 1e9);
+}
+
+void bench_print_header(void) {
+	printf("suite,engine,buffer_count,producers,consumers,operations,seconds,mops,p50_ns,p99_ns,p999_ns,max_ns,seq_bits\n");
+}
+
+void bench_print_throughput(const char *suite, const char *engine, LONG buffer_count,
+	LONG producers, LONG consumers, LONG64 operations, double seconds) {
+	printf("%s,%s,%d,%d,%d,%lld,%.6f,%.3f,,,,,%d\n",
+		suite, engine, (int)buffer_count, (int)producers, (int)consumers,
+		(long long)operations, seconds, (double)operations / seconds / 1e6, BENCH_SEQ_BITS);
+}
+
+int bench_compare_latency(const void *p_first, const void *p_second) {
+	LONG64 first = *(const LONG64 *)p_first;
+	LONG64 second = *(const LONG64 *)p_second;
+	return (first < second) ? -1 : ((first > second) ? 1 : 0);
+}
+
+double bench_percentile_ns(LONG count, double percentile) {
+	return (double)g_latency[(LONG)((count - 1) * percentile)] / g_ticks_per_ns;
+}
+
+void bench_print_latency(const char *engine, LONG buffer_count, LONG count, double seconds) {
+	qsort(g_latency, count, sizeof(LONG64), &bench_compare_latency);
+
+	printf("latency,%s,%d,1,1,%d,%.6f,%.3f,%.1f,%.1f,%.1f,%.1f,%d\n",
+		engine, (int)buffer_count, (int)count, seconds, (double)count / seconds / 1e6,
+		bench_percentile_ns(count, 0.5), bench_percentile_ns(count, 0.99),
+		bench_percentile_ns(count, 0.999), bench_percentile_ns(count, 1.0), BENCH_SEQ_BITS);
+}
+
+void bench_verify(const char *engine, PBENCH_THREAD p_consumers, LONG consumers, LONG producers, LONG operation_count) {
+	LONG64 expected;
+	LONG64 checksum = 0;
+	LONG i;
+
+	expected = (LONG64)producers * operation_count * (operation_count - 1) / 2;
+
+	for (i = 0; i != consumers; ++i)
+	{
+		checksum += p_consumers[i].checksum;
+	}
+
+	if (expected != checksum)
+	{
+		fprintf(stderr, "%s: checksum mismatch: %lld != %lld\n", engine, (long long)checksum, (long long)expected);
+	}
+}
+
+//
+// SPSC
+//
+
+DWORD WINAPI bench_spsc_producer(LPVOID p_param) {
+	PBENCH_THREAD p_thread = (PBENCH_THREAD)p_param;
+	NTRINGB_SPSC_POS ringb_pos;
+	LONG pos;
+	LONG i;
+
+	ntringb_spsc_pos_init(&g_spsc, &ringb_pos);
+	bench_thread_enter(p_thread);
+
+	for (i = 0; i != p_thread->operation_count; ++i)
+	{
+		pos = ntringb_spsc_begin_write(&ringb_pos);
+		g_buffer[pos] = i;
+		ntringb_spsc_commit_write(&ringb_pos);
+	}
+
+	return 0;
+}
+
+DWORD WINAPI bench_spsc_consumer(LPVOID p_param) {
+	PBENCH_THREAD p_thread = (PBENCH_THREAD)p_param;
+	NTRINGB_SPSC_POS ringb_pos;
+	LONG pos;
+	LONG i;
+
+	ntringb_spsc_pos_init(&g_spsc, &ringb_pos);
+	bench_thread_enter(p_thread);
+
+	for (i = 0; i != p_thread->operation_count; ++i)
+	{
+		pos = ntringb_spsc_begin_read(&ringb_pos);
+		p_thread->checksum += g_buffer[pos];
+		ntringb_spsc_commit_read(&ringb_pos);
+	}
+
+	return 0;
+}
+
+DWORD WINAPI bench_spsc_ping(LPVOID p_param) {
+	PBENCH_THREAD p_thread = (PBENCH_THREAD)p_param;
+	NTRINGB_SPSC_POS ping_pos;
+	NTRINGB_SPSC_POS pong_pos;
+	LONG64 start_ticks;
+	LONG pos;
+	LONG i;
+
+	ntringb_spsc_pos_init(&g_spsc, &ping_pos);
+	ntringb_spsc_pos_init(&g_spsc_pong, &pong_pos);
+	bench_thread_enter(p_thread);
+
+	for (i = 0; i != p_thread->operation_count; ++i)
+	{
+		start_ticks = (LONG64)ReadTimeStampCounter();
+
+		pos = ntringb_spsc_begin_write(&ping_pos);
+		g_buffer[pos] = start_ticks;
+		ntringb_spsc_commit_write(&ping_pos);
+
+		pos = ntringb_spsc_begin_read(&pong_pos);
+		p_thread->checksum += g_buffer_pong[pos];
+		ntringb_spsc_commit_read(&pong_pos);
+
+		g_latency[i] = (LONG64)ReadTimeStampCounter() - start_ticks;
+	}
+
+	return 0;
+}
+
+DWORD WINAPI bench_spsc_pong(LPVOID p_param) {
+	PBENCH_THREAD p_thread = (PBENCH_THREAD)p_param;
+	NTRINGB_SPSC_POS ping_pos;
+	NTRINGB_SPSC_POS pong_pos;
+	LONG64 value;
+	LONG pos;
+	LONG i;
+
+	ntringb_spsc_pos_init(&g_spsc, &ping_pos);
+	ntringb_spsc_pos_init(&g_spsc_pong, &pong_pos);
+	bench_thread_enter(p_thread);
+
+	for (i = 0; i != p_thread->operation_count; ++i)
+	{
+		pos = ntringb_spsc_begin_read(&ping_pos);
+		value = g_buffer[pos];
+		ntringb_spsc_commit_read(&ping_pos);
+
+		pos = ntringb_spsc_begin_write(&pong_pos);
+		g_buffer_pong[pos] = value;
+		ntringb_spsc_commit_write(&pong_pos);
+	}
+
+	return 0;
+}
+
+//
+// MPSC (NTRINGB)
+//
+
+DWORD WINAPI bench_mpsc_producer(LPVOID p_param) {
+	PBENCH_THREAD p_thread = (PBENCH_THREAD)p_param;
+	NTRINGB_POS ringb_pos;
+	LONG pos;
+	LONG i;
+
+	ntringb_pos_init(&g_ringb, &ringb_pos);
+	bench_thread_enter(p_thread);
+
+	for (i = 0; i != p_thread->operation_count; ++i)
+	{
+		pos = ntringb_begin_write(&ringb_pos);
+		g_buffer[pos] = i;
+		ntringb_commit_write(&ringb_pos);
+	}
+
+	return 0;
+}
+
+DWORD WINAPI bench_mpsc_consumer(LPVOID p_param) {
+	PBENCH_THREAD p_thread = (PBENCH_THREAD)p_param;
+	NTRINGB_POS ringb_pos;
+	LONG pos;
+	LONG i;
+
+	ntringb_pos_init(&g_ringb, &ringb_pos);
+	bench_thread_enter(p_thread);
+
+	for (i = 0; i != p_thread->operation_count; ++i)
+	{
+		pos = ntringb_begin_read(&ringb_pos);
+		p_thread->checksum += g_buffer[pos];
+		ntringb_commit_read(&ringb_pos);
+	}
+
+	return 0;
+}
+
+DWORD WINAPI bench_mpsc_ping(LPVOID p_param) {
+	PBENCH_THREAD p_thread = (PBENCH_THREAD)p_param;
+	NTRINGB_POS ping_pos;
+	NTRINGB_POS pong_pos;
+	LONG64 start_ticks;
+	LONG pos;
+	LONG i;
+
+	ntringb_pos_init(&g_ringb, &ping_pos);
+	ntringb_pos_init(&g_ringb_pong, &pong_pos);
+	bench_thread_enter(p_thread);
+
+	for (i = 0; i != p_thread->operation_count; ++i)
+	{
+		start_ticks = (LONG64)ReadTimeStampCounter();
+
+		pos = ntringb_begin_write(&ping_pos);
+		g_buffer[pos] = start_ticks;
+		ntringb_commit_write(&ping_pos);
+
+		pos = ntringb_begin_read(&pong_pos);
+		p_thread->checksum += g_buffer_pong[pos];
+		ntringb_commit_read(&pong_pos);
+
+		g_latency[i] = (LONG64)ReadTimeStampCounter() - start_ticks;
+	}
+
+	return 0;
+}
+
+DWORD WINAPI bench_mpsc_pong(LPVOID p_param) {
+	PBENCH_THREAD p_thread = (PBENCH_THREAD)p_param;
+	NTRINGB_POS ping_pos;
+	NTRINGB_POS pong_pos;
+	LONG64 value;
+	LONG pos;
+	LONG i;
+
+	ntringb_pos_init(&g_ringb, &ping_pos);
+	ntringb_pos_init(&g_ringb_pong, &pong_pos);
+	bench_thread_enter(p_thread);
+
+	for (i = 0; i != p_thread->operation_count; ++i)
+	{
+		pos = ntringb_begin_read(&ping_pos);
+		value = g_buffer[pos];
+		ntringb_commit_read(&ping_pos);
+
+		pos = ntringb_begin_write(&pong_pos);
+		g_buffer_pong[pos] = value;
+		ntringb_commit_write(&pong_pos);
+	}
+
+	return 0;
+}
+
+DWORD WINAPI bench_mpsc_uncontended(LPVOID p_param) {
+	PBENCH_THREAD p_thread = (PBENCH_THREAD)p_param;
+	NTRINGB_POS writer_pos;
+	NTRINGB_POS reader_pos;
+	LONG pos;
+	LONG i;
+
+	// Same thread writes and reads each element, so that interlocked operations never contend
+	ntringb_pos_init(&g_ringb, &writer_pos);
+	ntringb_pos_init(&g_ringb, &reader_pos);
+	bench_thread_enter(p_thread);
+
+	for (i = 0; i != p_thread->operation_count; ++i)
+	{
+		pos = ntringb_begin_write(&writer_pos);
+		g_buffer[pos] = i;
+		ntringb_commit_write(&writer_pos);
+
+		pos = ntringb_begin_read(&reader_pos);
+		p_thread->checksum += g_buffer[pos];
+		ntringb_commit_read(&reader_pos);
+	}
+
+	return 0;
+}
+
+//
+// MPSC (NTRINGB_LANES)
+//
+
+DWORD WINAPI bench_lanes_producer(LPVOID p_param) {
+	PBENCH_THREAD p_thread = (PBENCH_THREAD)p_param;
+	NTRINGB_LANES_POS lanes_pos;
+	LONG pos;
+	LONG i;
+
+	// Consumer is thread 0, and producer of each lane is one of the threads that follow
+	ntringb_lanes_pos_init(&g_lanes, p_thread->index - 1, &lanes_pos);
+	bench_thread_enter(p_thread);
+
+	for (i = 0; i != p_thread->operation_count; ++i)
+	{
+		pos = ntringb_lanes_begin_write(&lanes_pos);
+		g_lane_buffer[pos] = i;
+		ntringb_lanes_commit_write(&lanes_pos);
+	}
+
+	return 0;
+}
+
+DWORD WINAPI bench_lanes_consumer(LPVOID p_param) {
+	PBENCH_THREAD p_thread = (PBENCH_THREAD)p_param;
+	LONG lane_index;
+	LONG contiguous_count;
+	LONG count;
+	LONG pos;
+	LONG i;
+	LONG j;
+
+	bench_thread_enter(p_thread);
+
+	for (i = 0; i < p_thread->operation_count; i += count)
+	{
+		count = ntringb_lanes_begin_drain(&g_lanes, 64, &lane_index, &pos, &contiguous_count);
+
+		if (0 == count)
+		{
+			YieldProcessor();
+			continue;
+		}
+
+		for (j = 0; j != contiguous_count; ++j)
+		{
+			p_thread->checksum += g_lane_buffer[pos + j];
+		}
+
+		// Second part of the batch, which wrapped around the end of the lane
+		for (pos = NTRINGB_LANE_BASE(&g_lanes, lane_index); j != count; ++j, ++pos)
+		{
+			p_thread->checksum += g_lane_buffer[pos];
+		}
+
+		ntringb_lanes_commit_drain(&g_lanes);
+	}
+
+	return 0;
+}
+
+//
+// MPMC (NTRINGB_MPMC)
+//
+
+DWORD WINAPI bench_mpmc_producer(LPVOID p_param) {
+	PBENCH_THREAD p_thread = (PBENCH_THREAD)p_param;
+	NTRINGB_MPMC_POS ringb_pos;
+	LONG pos;
+	LONG i;
+
+	ntringb_mpmc_pos_init(&g_mpmc, &ringb_pos);
+	bench_thread_enter(p_thread);
+
+	for (i = 0; i != p_thread->operation_count; ++i)
+	{
+		pos = ntringb_mpmc_begin_write(&ringb_pos);
+		g_buffer[pos] = i;
+		ntringb_mpmc_commit_write(&ringb_pos);
+	}
+
+	return 0;
+}
+
+DWORD WINAPI bench_mpmc_consumer(LPVOID p_param) {
+	PBENCH_THREAD p_thread = (PBENCH_THREAD)p_param;
+	NTRINGB_MPMC_POS ringb_pos;
+	LONG pos;
+	LONG i;
+
+	ntringb_mpmc_pos_init(&g_mpmc, &ringb_pos);
+	bench_thread_enter(p_thread);
+
+	for (i = 0; i != p_thread->operation_count; ++i)
+	{
+		pos = ntringb_mpmc_begin_read(&ringb_pos);
+		p_thread->checksum += g_buffer[pos];
+		ntringb_mpmc_commit_read(&ringb_pos);
+	}
+
+	return 0;
+}
+
+//
+// Poll
+//
+
+DWORD WINAPI bench_poll_acquire(LPVOID p_param) {
+	PBENCH_THREAD p_thread = (PBENCH_THREAD)p_param;
+	NTRINGB_POS ringb_pos;
+	LONG i;
+
+	// Ring-buffer is empty, so every poll checks position and fails
+	ntringb_pos_init(&g_ringb, &ringb_pos);
+	ringb_pos.current_pos = 1;
+	bench_thread_enter(p_thread);
+
+	for (i = 0; i != p_thread->operation_count; ++i)
+	{
+		p_thread->checksum += ntringb_poll_read_ready(&ringb_pos);
+	}
+
+	return 0;
+}
+
+DWORD WINAPI bench_poll_full_barrier(LPVOID p_param) {
+	PBENCH_THREAD p_thread = (PBENCH_THREAD)p_param;
+	NTRINGB_POS ringb_pos;
+	LONG i;
+
+	// Same as NTRINGB_POLL_FULL_BARRIER
+	ntringb_pos_init(&g_ringb, &ringb_pos);
+	ringb_pos.current_pos = 1;
+	bench_thread_enter(p_thread);
+
+	for (i = 0; i != p_thread->operation_count; ++i)
+	{
+		MemoryBarrier();
+		p_thread->checksum += ntringb_poll_read_ready(&ringb_pos);
+	}
+
+	return 0;
+}
+
+//
+// NTARC
+//
+
+void bench_arc_destroy(PVOID p_context, PNTARC p_arc) {
+	// Values are static, and main holds reference to them until the end
+	UNREFERENCED_PARAMETER(p_context);
+	UNREFERENCED_PARAMETER(p_arc);
+}
+
+DWORD WINAPI bench_arc_reader(LPVOID p_param) {
+	PBENCH_THREAD p_thread = (PBENCH_THREAD)p_param;
+	NTARC arc;
+	LONG i;
+
+	bench_thread_enter(p_thread);
+
+	for (i = 0; i != p_thread->operation_count; ++i)
+	{
+		ntarc_atomic_load(&g_arc, &arc);
+		p_thread->checksum += *NTARC_PDATA((&arc), LONG64);
+		ntarc_drop(&arc);
+	}
+
+	return 0;
+}
+
+DWORD WINAPI bench_arc_borrower(LPVOID p_param) {
+	PBENCH_THREAD p_thread = (PBENCH_THREAD)p_param;
+	NTARC_BORROW borrow;
+	LONG i;
+
+	bench_thread_enter(p_thread);
+
+	for (i = 0; i != p_thread->operation_count; ++i)
+	{
+		p_thread->checksum += *(LONG64*)ntarc_borrow_begin(&g_arc, &borrow);
+		ntarc_borrow_end(&borrow);
+	}
+
+	return 0;
+}
+
+DWORD WINAPI bench_arc_writer(LPVOID p_param) {
+	PBENCH_THREAD p_thread = (PBENCH_THREAD)p_param;
+	LONG i;
+
+	bench_thread_enter(p_thread);
+
+	for (i = 0; i != p_thread->operation_count; ++i)
+	{
+		ntarc_atomic_store(&g_arc, &g_arc_values[i & 1]);
+	}
+
+	return 0;
+}
+
+DWORD WINAPI bench_arc_background_writer(LPVOID p_param) {
+	PBENCH_THREAD p_thread = (PBENCH_THREAD)p_param;
+	LONG i;
+
+	bench_thread_enter(p_thread);
+
+	for (i = 0; 0 == g_stop; ++i)
+	{
+		ntarc_atomic_store(&g_arc, &g_arc_values[i & 1]);
+	}
+
+	return 0;
+}
+
+//
+// Suites
+//
+
+void bench_ringb_throughput(LONG buffer_count, LONG operation_count) {
+	PFN_BENCH_THREAD routines[BENCH_MAX_THREAD_COUNT];
+	BENCH_THREAD threads[BENCH_MAX_THREAD_COUNT];
+	double seconds;
+	LONG producers;
+	LONG i;
+
+	// SPSC: one producer, one consumer
+	ntringb_spsc_init(&g_spsc, buffer_count);
+	routines[0] = &bench_spsc_consumer;
+	routines[1] = &bench_spsc_producer;
+	threads[0].operation_count = operation_count;
+	threads[1].operation_count = operation_count;
+	seconds = bench_run(routines, threads, 2, 2);
+	bench_verify("spsc", threads, 1, 1, operation_count);
+	bench_print_throughput("throughput", "spsc", buffer_count, 1, 1, operation_count, seconds);
+
+	// MPSC: many producers, one consumer
+	for (producers = 1; (producers == 1) || (producers + 1 <= g_cpu_count && producers + 1 <= BENCH_MAX_THREAD_COUNT); producers <<= 1)
+	{
+		ntringb_init(&g_ringb, buffer_count);
+		routines[0] = &bench_mpsc_consumer;
+		threads[0].operation_count = producers * operation_count;
+
+		for (i = 1; i <= producers; ++i)
+		{
+			routines[i] = &bench_mpsc_producer;
+			threads[i].operation_count = operation_count;
+		}
+
+		seconds = bench_run(routines, threads, producers + 1, producers + 1);
+		bench_verify("mpsc", threads, 1, producers, operation_count);
+		bench_print_throughput("throughput", "mpsc", buffer_count, producers, 1, (LONG64)producers * operation_count, seconds);
+	}
+
+	// MPSC lanes: one SPSC lane per producer, one consumer
+	for (producers = 1; (producers == 1) || (producers + 1 <= g_cpu_count && producers + 1 <= BENCH_MAX_THREAD_COUNT); producers <<= 1)
+	{
+		ntringb_lanes_init(&g_lanes, g_lane_array, producers, buffer_count, NULL);
+		routines[0] = &bench_lanes_consumer;
+		threads[0].operation_count = producers * operation_count;
+
+		for (i = 1; i <= producers; ++i)
+		{
+			routines[i] = &bench_lanes_producer;
+			threads[i].operation_count = operation_count;
+		}
+
+		seconds = bench_run(routines, threads, producers + 1, producers + 1);
+		bench_verify("lanes", threads, 1, producers, operation_count);
+		bench_print_throughput("throughput", "lanes", buffer_count, producers, 1, (LONG64)producers * operation_count, seconds);
+	}
+
+	// MPMC: same count of producers and consumers
+	for (producers = 1; (producers == 1) || (2 * producers <= g_cpu_count && 2 * producers <= BENCH_MAX_THREAD_COUNT); producers <<= 1)
+	{
+		ntringb_mpmc_init(&g_mpmc, g_mpmc_sequence, buffer_count);
+
+		for (i = 0; i != producers; ++i)
+		{
+			routines[i] = &bench_mpmc_consumer;
+			threads[i].operation_count = operation_count;
+			routines[producers + i] = &bench_mpmc_producer;
+			threads[producers + i].operation_count = operation_count;
+		}
+
+		seconds = bench_run(routines, threads, 2 * producers, 2 * producers);
+		bench_verify("mpmc", threads, producers, producers, operation_count);
+		bench_print_throughput("throughput", "mpmc", buffer_count, producers, producers, (LONG64)producers * operation_count, seconds);
+	}
+}
+
+void bench_ringb_latency(void) {
+	PFN_BENCH_THREAD routines[2];
+	BENCH_THREAD threads[2];
+	double seconds;
+
+	ntringb_spsc_init(&g_spsc, BENCH_LATENCY_BUFFER_COUNT);
+	ntringb_spsc_init(&g_spsc_pong, BENCH_LATENCY_BUFFER_COUNT);
+	routines[0] = &bench_spsc_ping;
+	routines[1] = &bench_spsc_pong;
+	threads[0].operation_count = BENCH_LATENCY_SAMPLE_COUNT;
+	threads[1].operation_count = BENCH_LATENCY_SAMPLE_COUNT;
+	seconds = bench_run(routines, threads, 2, 2);
+	bench_print_latency("spsc", BENCH_LATENCY_BUFFER_COUNT, BENCH_LATENCY_SAMPLE_COUNT, seconds);
+
+	ntringb_init(&g_ringb, BENCH_LATENCY_BUFFER_COUNT);
+	ntringb_init(&g_ringb_pong, BENCH_LATENCY_BUFFER_COUNT);
+	routines[0] = &bench_mpsc_ping;
+	routines[1] = &bench_mpsc_pong;
+	seconds = bench_run(routines, threads, 2, 2);
+	bench_print_latency("mpsc", BENCH_LATENCY_BUFFER_COUNT, BENCH_LATENCY_SAMPLE_COUNT, seconds);
+}
+
+void bench_seq(LONG operation_count) {
+	PFN_BENCH_THREAD routines[BENCH_MAX_THREAD_COUNT];
+	BENCH_THREAD threads[BENCH_MAX_THREAD_COUNT];
+	double seconds;
+	LONG producers;
+	LONG i;
+
+	// Uncontended: one thread writes and reads each element
+	ntringb_init(&g_ringb, BENCH_LATENCY_BUFFER_COUNT);
+	routines[0] = &bench_mpsc_uncontended;
+	threads[0].operation_count = operation_count;
+	seconds = bench_run(routines, threads, 1, 1);
+	bench_verify("uncontended", threads, 1, 1, operation_count);
+	bench_print_throughput("seq", "uncontended", BENCH_LATENCY_BUFFER_COUNT, 1, 1, operation_count, seconds);
+
+	// Contended: producer on every other CPU, where cost of interlocked operations on positions shows
+	producers = g_cpu_count - 1;
+
+	if (producers < 1)
+	{
+		producers = 1;
+	}
+
+	if (producers + 1 > BENCH_MAX_THREAD_COUNT)
+	{
+		producers = BENCH_MAX_THREAD_COUNT - 1;
+	}
+
+	ntringb_init(&g_ringb, BENCH_LATENCY_BUFFER_COUNT);
+	routines[0] = &bench_mpsc_consumer;
+	threads[0].operation_count = producers * operation_count;
+
+	for (i = 1; i <= producers; ++i)
+	{
+		routines[i] = &bench_mpsc_producer;
+		threads[i].operation_count = operation_count;
+	}
+
+	seconds = bench_run(routines, threads, producers + 1, producers + 1);
+	bench_verify("mpsc", threads, 1, producers, operation_count);
+	bench_print_throughput("seq", "mpsc", BENCH_LATENCY_BUFFER_COUNT, producers, 1, (LONG64)producers * operation_count, seconds);
+}
+
+void bench_poll(LONG operation_count) {
+	PFN_BENCH_THREAD routines[1];
+	BENCH_THREAD threads[1];
+	double seconds;
+
+	ntringb_init(&g_ringb, BENCH_LATENCY_BUFFER_COUNT);
+	threads[0].operation_count = operation_count;
+
+	routines[0] = &bench_poll_acquire;
+	seconds = bench_run(routines, threads, 1, 1);
+	bench_print_throughput("poll", "acquire", BENCH_LATENCY_BUFFER_COUNT, 0, 1, operation_count, seconds);
+
+	routines[0] = &bench_poll_full_barrier;
+	seconds = bench_run(routines, threads, 1, 1);
+	bench_print_throughput("poll", "full_barrier", BENCH_LATENCY_BUFFER_COUNT, 0, 1, operation_count, seconds);
+}
+
+void bench_arc(LONG operation_count) {
+	PFN_BENCH_THREAD routines[BENCH_MAX_THREAD_COUNT];
+	BENCH_THREAD threads[BENCH_MAX_THREAD_COUNT];
+	NTARC null_arc = { 0, 0 };
+	double seconds;
+	LONG thread_count;
+	LONG i;
+
+	for (i = 0; i != 2; ++i)
+	{
+		ntarc_new(&g_arc_data[i], NULL, &bench_arc_destroy, &g_arc_control_blocks[i], &g_arc_values[i]);
+	}
+
+	ntarc_atomic_store(&g_arc, &g_arc_values[0]);
+
+	// Readers only
+	for (thread_count = 1; thread_count <= g_cpu_count && thread_count <= BENCH_MAX_THREAD_COUNT; thread_count <<= 1)
+	{
+		for (i = 0; i != thread_count; ++i)
+		{
+			routines[i] = &bench_arc_reader;
+			threads[i].operation_count = operation_count;
+		}
+
+		seconds = bench_run(routines, threads, thread_count, thread_count);
+		bench_print_throughput("arc_load", "ntarc", 0, 0, thread_count, (LONG64)thread_count * operation_count, seconds);
+	}
+
+	// Borrowers only
+	for (thread_count = 1; thread_count <= g_cpu_count && thread_count <= BENCH_MAX_THREAD_COUNT; thread_count <<= 1)
+	{
+		for (i = 0; i != thread_count; ++i)
+		{
+			routines[i] = &bench_arc_borrower;
+			threads[i].operation_count = operation_count;
+		}
+
+		seconds = bench_run(routines, threads, thread_count, thread_count);
+		bench_print_throughput("arc_borrow", "ntarc", 0, 0, thread_count, (LONG64)thread_count * operation_count, seconds);
+	}
+
+	// Readers with one writer storing in the background
+	for (thread_count = 1; (thread_count == 1) || (thread_count + 1 <= g_cpu_count && thread_count + 1 <= BENCH_MAX_THREAD_COUNT); thread_count <<= 1)
+	{
+		for (i = 0; i != thread_count; ++i)
+		{
+			routines[i] = &bench_arc_reader;
+			threads[i].operation_count = operation_count;
+		}
+
+		routines[thread_count] = &bench_arc_background_writer;
+		seconds = bench_run(routines, threads, thread_count + 1, thread_count);
+		bench_print_throughput("arc_load_with_store", "ntarc", 0, 1, thread_count, (LONG64)thread_count * operation_count, seconds);
+	}
+
+	// Writers only
+	for (thread_count = 1; thread_count <= g_cpu_count && thread_count <= BENCH_MAX_THREAD_COUNT; thread_count <<= 1)
+	{
+		for (i = 0; i != thread_count; ++i)
+		{
+			routines[i] = &bench_arc_writer;
+			threads[i].operation_count = operation_count;
+		}
+
+		seconds = bench_run(routines, threads, thread_count, thread_count);
+		bench_print_throughput("arc_store", "ntarc", 0, thread_count, 0, (LONG64)thread_count * operation_count, seconds);
+	}
+
+	ntarc_atomic_store(&g_arc, &null_arc);
+
+	for (i = 0; i != 2; ++i)
+	{
+		ntarc_drop(&g_arc_values[i]);
+	}
+}
+
+int main(int argc, char** argv)
+{
+	SYSTEM_INFO system_info;
+	LONG operation_count = BENCH_DEFAULT_OPERATION_COUNT;
+	LONG buffer_count;
+
+	if (argc > 1)
+	{
+		operation_count = atol(argv[1]);
+	}
+
+	GetSystemInfo(&system_info);
+	g_cpu_count = (LONG)system_info.dwNumberOfProcessors;
+
+	bench_calibrate();
+	bench_print_header();
+
+	for (buffer_count = 64; buffer_count <= BENCH_MAX_BUFFER_COUNT; buffer_count <<= 4)
+	{
+		bench_ringb_throughput(buffer_count, operation_count);
+	}
+
+	bench_ringb_latency();
+	bench_seq(operation_count);
+	bench_poll(operation_count);
+	bench_arc(operation_count);
+
+	return 0;
+}
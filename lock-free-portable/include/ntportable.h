@@ -0,0 +1,224 @@
+// 
+// NTPORTABLE is header-only C layer of portable atomics used by NTRINGB and NTARC
+// 
+// On other than Windows targets NTRINGB and NTARC include this header instead of
+// <winnt.h>. It defines the few Windows types and interlocked operations they
+// use with GCC or Clang __atomic builtins for x86-64 and ARM64, so that both
+// libraries share single definition, and can be used together.
+// 
+// On Linux sched_getcpu() is declared by <sched.h> only with _GNU_SOURCE, so
+// include this header (or NTRINGB and NTARC) before other system headers, or
+// define _GNU_SOURCE on command line.
+//
+// LICENSE
+// =======
+//   The MIT License(MIT) Copyright(c) 2024, Sadhbh C0d3
+//
+//   Permission is hereby granted, free of charge, to any person obtaining a copy of
+//   this software and associated documentation files(the "Software"), to deal in
+//   the Software without restriction, including without limitation the rights to
+//   use, copy, modify, merge, publish, distribute, sublicense, and /or sell copies
+//   of the Software, and to permit persons to whom the Software is furnished to do
+//   so, subject to the following conditions :
+//
+//   The above copyright notice and this permission notice shall be included in all
+//   copies or substantial portions of the Software.
+//
+//   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+//   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//   SOFTWARE.
+
+#pragma once
+
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __x86_64__
+#include <x86intrin.h>
+#endif
+
+#ifdef __linux__
+#include <sched.h>
+#endif
+
+typedef int32_t LONG, *PLONG;
+typedef uint32_t ULONG;
+typedef int64_t LONG64;
+typedef uint64_t ULONG64;
+typedef uint16_t USHORT;
+typedef uint8_t UCHAR, *PUCHAR;
+typedef int BOOL;
+typedef uint8_t BOOLEAN;
+typedef void VOID, *PVOID;
+typedef size_t SIZE_T;
+
+#define TRUE 1
+#define FALSE 0
+
+#define DECLSPEC_ALIGN(x) __attribute__((aligned(x)))
+#define DECLSPEC_SELECTANY __attribute__((weak))
+#define UNREFERENCED_PARAMETER(p) ((void)(p))
+#define TYPE_ALIGNMENT(t) __alignof__(t)
+#define MEMORY_ALLOCATION_ALIGNMENT 16
+#define RtlCopyMemory(d, s, n) __builtin_memcpy((d), (s), (n))
+
+// Interlocked operations are full barriers, same as on Windows
+#define InterlockedIncrement(p) __atomic_add_fetch((p), 1, __ATOMIC_SEQ_CST)
+#define InterlockedIncrement64(p) __atomic_add_fetch((p), 1, __ATOMIC_SEQ_CST)
+#define InterlockedDecrement(p) __atomic_sub_fetch((p), 1, __ATOMIC_SEQ_CST)
+#define InterlockedExchangeAdd(p, v) __atomic_fetch_add((p), (v), __ATOMIC_SEQ_CST)
+#define InterlockedExchangeAdd64(p, v) __atomic_fetch_add((p), (v), __ATOMIC_SEQ_CST)
+#define InterlockedExchange(p, v) __atomic_exchange_n((p), (v), __ATOMIC_SEQ_CST)
+#define InterlockedExchange64(p, v) __atomic_exchange_n((p), (v), __ATOMIC_SEQ_CST)
+#define InterlockedOr64(p, v) __atomic_fetch_or((p), (v), __ATOMIC_SEQ_CST)
+#define InterlockedAnd64(p, v) __atomic_fetch_and((p), (v), __ATOMIC_SEQ_CST)
+#define InterlockedCompareExchange(p, v, c) __sync_val_compare_and_swap((p), (c), (v))
+#define InterlockedCompareExchange64(p, v, c) __sync_val_compare_and_swap((p), (c), (v))
+#define InterlockedCompareExchange128(p, h, l, pc) ntportable_compare_exchange128((p), (h), (l), (pc))
+
+#define ReadAcquire(p) __atomic_load_n((p), __ATOMIC_ACQUIRE)
+#define ReadAcquire64(p) __atomic_load_n((p), __ATOMIC_ACQUIRE)
+#define WriteRelease(p, v) __atomic_store_n((p), (v), __ATOMIC_RELEASE)
+#define WriteRelease64(p, v) __atomic_store_n((p), (v), __ATOMIC_RELEASE)
+#define MemoryBarrier() __atomic_thread_fence(__ATOMIC_SEQ_CST)
+
+#ifdef __aarch64__
+#define __rdtsc() ntportable_read_counter()
+#endif
+
+// Time-stamp counter, same as ReadTimeStampCounter() on Windows
+#define ReadTimeStampCounter() ((ULONG64)__rdtsc())
+
+#ifndef YieldProcessor
+#if defined(__x86_64__)
+#define YieldProcessor() __builtin_ia32_pause()
+#elif defined(__aarch64__)
+#define YieldProcessor() __asm__ __volatile__("yield" ::: "memory")
+#else
+#define YieldProcessor() ((void)0)
+#endif
+#endif
+
+/// <summary>
+/// 128-bit CAS, same as InterlockedCompareExchange128() on Windows
+/// 
+/// Note: destination must be aligned to 16 bytes. On x86-64 this is CMPXCHG16B,
+/// on ARM64 it is CASPAL with LSE (-march=armv8.1-a), and LDAXP/STLXP loop otherwise.
+/// </summary>
+/// <param name="p_destination">A pointer to 128-bit destination</param>
+/// <param name="exchange_high">High 64 bits of new value</param>
+/// <param name="exchange_low">Low 64 bits of new value</param>
+/// <param name="p_comparand">A pointer to expected value, receiving value of destination</param>
+/// <returns>TRUE if new value was stored, FALSE otherwise</returns>
+static __inline__ BOOLEAN ntportable_compare_exchange128(volatile LONG64 *p_destination,
+	LONG64 exchange_high, LONG64 exchange_low, LONG64 *p_comparand) {
+#if defined(__x86_64__)
+	BOOLEAN result;
+
+	__asm__ __volatile__("lock cmpxchg16b %1\n\tsete %0"
+		: "=q"(result), "+m"(*(volatile __int128*)p_destination), "+a"(p_comparand[0]), "+d"(p_comparand[1])
+		: "b"(exchange_low), "c"(exchange_high)
+		: "memory", "cc");
+
+	return result;
+#elif defined(__aarch64__) && defined(__ARM_FEATURE_ATOMICS)
+	register LONG64 old_low __asm__("x0") = p_comparand[0];
+	register LONG64 old_high __asm__("x1") = p_comparand[1];
+	register LONG64 new_low __asm__("x2") = exchange_low;
+	register LONG64 new_high __asm__("x3") = exchange_high;
+	BOOLEAN result;
+
+	__asm__ __volatile__("caspal x0, x1, x2, x3, [%[p]]"
+		: "+r"(old_low), "+r"(old_high)
+		: "r"(new_low), "r"(new_high), [p]"r"(p_destination)
+		: "memory");
+
+	result = (old_low == p_comparand[0] && old_high == p_comparand[1]);
+	p_comparand[0] = old_low;
+	p_comparand[1] = old_high;
+
+	return result;
+#elif defined(__aarch64__)
+	LONG64 old_low;
+	LONG64 old_high;
+	ULONG failed;
+	BOOLEAN result;
+
+	// On mismatch old value is stored back, so that it is read atomically
+	__asm__ __volatile__(
+		"1: ldaxp %[ol], %[oh], [%[p]]\n"
+		"   cmp %[ol], %[cl]\n"
+		"   ccmp %[oh], %[ch], #0, eq\n"
+		"   b.ne 2f\n"
+		"   stlxp %w[f], %[nl], %[nh], [%[p]]\n"
+		"   cbnz %w[f], 1b\n"
+		"   b 3f\n"
+		"2: stlxp %w[f], %[ol], %[oh], [%[p]]\n"
+		"   cbnz %w[f], 1b\n"
+		"3:\n"
+		: [ol]"=&r"(old_low), [oh]"=&r"(old_high), [f]"=&r"(failed)
+		: [p]"r"(p_destination), [cl]"r"(p_comparand[0]), [ch]"r"(p_comparand[1]),
+		  [nl]"r"(exchange_low), [nh]"r"(exchange_high)
+		: "memory", "cc");
+
+	result = (old_low == p_comparand[0] && old_high == p_comparand[1]);
+	p_comparand[0] = old_low;
+	p_comparand[1] = old_high;
+
+	return result;
+#else
+	unsigned __int128 expected = ((unsigned __int128)(ULONG64)p_comparand[1] << 64) | (ULONG64)p_comparand[0];
+	unsigned __int128 desired = ((unsigned __int128)(ULONG64)exchange_high << 64) | (ULONG64)exchange_low;
+	unsigned __int128 old_value;
+
+	old_value = __sync_val_compare_and_swap((volatile unsigned __int128*)p_destination, expected, desired);
+	p_comparand[0] = (LONG64)old_value;
+	p_comparand[1] = (LONG64)(old_value >> 64);
+
+	return (old_value == expected);
+#endif
+}
+
+static __inline__ BOOLEAN BitScanForward64(ULONG *p_index, ULONG64 mask) {
+	if (0 == mask) {
+		return FALSE;
+	}
+
+	*p_index = (ULONG)__builtin_ctzll(mask);
+	return TRUE;
+}
+
+static __inline__ BOOLEAN BitScanReverse64(ULONG *p_index, ULONG64 mask) {
+	if (0 == mask) {
+		return FALSE;
+	}
+
+	*p_index = 63 - (ULONG)__builtin_clzll(mask);
+	return TRUE;
+}
+
+static __inline__ BOOLEAN BitScanReverse(ULONG *p_index, ULONG mask) {
+	if (0 == mask) {
+		return FALSE;
+	}
+
+	*p_index = 31 - (ULONG)__builtin_clz(mask);
+	return TRUE;
+}
+
+#ifdef __aarch64__
+static __inline__ ULONG64 ntportable_read_counter(void) {
+	ULONG64 counter;
+
+	__asm__ __volatile__("mrs %0, cntvct_el0" : "=r"(counter));
+	return counter;
+}
+#endif
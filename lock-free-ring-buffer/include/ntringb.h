@@ -1,6 +1,9 @@
 // 
 // NTRINGB is header-only C library that can be used in Windows Kernel Mode
 // 
+// On other than Windows targets it builds with GCC or Clang using portable atomics
+// for x86-64 and ARM64 from ntportable.h (lock-free-portable/include).
+// 
 // NOTE
 // ====
 //   NTRINGB is Lock-Free implementation of the Ring-Buffer.
@@ -9,6 +12,19 @@
 //		2. Can be used also as MPMC, however multiple-consumers will consume elements
 //		   unordered, and also each element will be consumed by exactly one consumer.
 //		3. Can be used in asynchronious way (co-routine) by using poll functions.
+//		4. Dedicated SPSC ring-buffer (NTRINGB_SPSC) without interlocked instructions.
+//		5. Alternative MPMC ring-buffer (NTRINGB_MPMC) with per-element sequence numbers,
+//		   where producers and consumers commit out-of-order.
+//		6. Broadcast ring-buffer (NTRINGB_BCAST), where each element is read by all
+//		   registered consumers.
+//		7. Message ring-buffer (NTRINGB_MSG) of variable-length records.
+//		8. Readiness set (NTRINGB_SET) for single consumer of up to 64 ring-buffers.
+//		9. Allocation of ring-buffer on large pages on chosen NUMA node (NTRINGB_NUMA_ALLOC).
+//		10. Shared ring-buffer (NTRINGB_SHARED) in memory section mapped into driver and process.
+//		11. Timed begin functions, closed state, and abandoning of claimed elements.
+//		12. Work-stealing deque (NTRINGB_DEQUE) for load balancing between consumers.
+//		13. Multi-lane ring-buffer (NTRINGB_LANES) of SPSC lanes, one per producer.
+//		14. Snapshot of positions, and tap recording committed elements (NTRINGB_TAP).
 //
 // LICENSE
 // =======
@@ -34,20 +50,294 @@
 
 #pragma once
 
+#ifdef _WIN32
 #include <winnt.h>
+#else
+#include "ntportable.h"
+#endif
+
+// Size of the cache line used to separate fields of ring-buffer control structures.
+// Use 128 on CPUs with adjacent cache line prefetch, so that both lines of the pair
+// are owned by the same side.
+#ifndef NTRINGB_CACHE_LINE_SIZE
+#define NTRINGB_CACHE_LINE_SIZE 64
+#endif
+
+// Define NTRINGB_PADDED to place each counter of the ring-buffer on its own cache line.
+// This removes false-sharing between producers and consumers at the cost of memory.
+#ifdef NTRINGB_PADDED
+#define NTRINGB_CACHE_ALIGN DECLSPEC_ALIGN(NTRINGB_CACHE_LINE_SIZE)
+#else
+#define NTRINGB_CACHE_ALIGN
+#endif
+
+// Define NTRINGB_SEQ64 to use 64-bit positions, which never wrap around in practice.
+// This is intended for 64-bit targets, where 64-bit interlocked operations are native.
+#ifdef NTRINGB_SEQ64
+typedef LONG64 NTRINGB_SEQ;
+#define NTRINGB_INTERLOCKED_INCREMENT InterlockedIncrement64
+#define NTRINGB_INTERLOCKED_EXCHANGE_ADD InterlockedExchangeAdd64
+#define NTRINGB_INTERLOCKED_COMPARE_EXCHANGE InterlockedCompareExchange64
+#define NTRINGB_READ_ACQUIRE ReadAcquire64
+#define NTRINGB_WRITE_RELEASE WriteRelease64
+#else
+typedef LONG NTRINGB_SEQ;
+#define NTRINGB_INTERLOCKED_INCREMENT InterlockedIncrement
+#define NTRINGB_INTERLOCKED_EXCHANGE_ADD InterlockedExchangeAdd
+#define NTRINGB_INTERLOCKED_COMPARE_EXCHANGE InterlockedCompareExchange
+#define NTRINGB_READ_ACQUIRE ReadAcquire
+#define NTRINGB_WRITE_RELEASE WriteRelease
+#endif
+
+// Waiting and polling read positions with acquire loads, and commit functions publish them
+// with interlocked operations or release stores, so that no full barrier is needed for each
+// check. Define NTRINGB_POLL_FULL_BARRIER to issue MemoryBarrier() before each check of
+// polling functions, and in busy spin, e.g. when code outside relies on full barrier.
+#ifdef NTRINGB_POLL_FULL_BARRIER
+#define NTRINGB_POLL_BARRIER() MemoryBarrier()
+#else
+#define NTRINGB_POLL_BARRIER()
+#endif
+
+// Wait policy of blocking begin functions. Waiting thread first spins with YieldProcessor()
+// for NTRINGB_WAIT_SPIN_COUNT iterations, and then backs off exponentially up to
+// 2^NTRINGB_WAIT_BACKOFF_LIMIT iterations of YieldProcessor() between checks.
+//
+// Define NTRINGB_WAIT_BUSY_SPIN to spin without YieldProcessor() and backoff.
+//
+// Define NTRINGB_PARK(p_address, p_observed) and NTRINGB_UNPARK(p_address) to allow
+// waiting thread to park once backoff reaches its limit. NTRINGB_PARK must return when
+// value at p_address differs from value at p_observed, or when NTRINGB_UNPARK is called
+// for that address. Commit functions call NTRINGB_UNPARK only if there is a parked thread.
+// In User Mode define NTRINGB_WAIT_ON_ADDRESS to use WaitOnAddress() and WakeByAddressAll()
+// (include <Windows.h> first, and link Synchronization.lib). In Kernel Mode you can for
+// example implement NTRINGB_PARK with KeWaitForSingleObject() on KEVENT.
+//
+// Define NTRINGB_PARK_SLICE(p_address, p_observed) to allow timed begin functions to park
+// too. It must return when NTRINGB_PARK would, or after short time, so that waiting thread
+// can check its deadline, e.g. KeWaitForSingleObject() with timeout. With NTRINGB_WAIT_ON_ADDRESS
+// it is WaitOnAddress() with timeout of NTRINGB_PARK_SLICE_MS milliseconds. Without it timed
+// begin functions back off, but don't park.
+#ifndef NTRINGB_WAIT_SPIN_COUNT
+#define NTRINGB_WAIT_SPIN_COUNT 1024
+#endif
+
+#ifndef NTRINGB_WAIT_BACKOFF_LIMIT
+#define NTRINGB_WAIT_BACKOFF_LIMIT 10
+#endif
+
+// Timed begin functions compare NTRINGB_TIMESTAMP() with deadline, which is ReadTimeStampCounter()
+// by default, i.e. __rdtsc() on x86 and x64, and counter register on ARM64, and you can define it
+// for example as KeQueryPerformanceCounter(NULL).QuadPart instead.
+#ifndef NTRINGB_TIMESTAMP
+#define NTRINGB_TIMESTAMP() ((LONG64)ReadTimeStampCounter())
+#endif
+
+// Status returned by timed begin functions
+#define NTRINGB_WAIT_SUCCESS 0
+#define NTRINGB_WAIT_TIMEOUT 1
+#define NTRINGB_WAIT_CLOSED 2
+
+// Index returned by blocking begin functions when ring-buffer was closed while waiting
+#define NTRINGB_CLOSED_POS (-1)
+
+#if defined(NTRINGB_WAIT_ON_ADDRESS) && !defined(NTRINGB_PARK)
+#define NTRINGB_PARK(p_address, p_observed) WaitOnAddress((volatile VOID *)(p_address), (PVOID)(p_observed), sizeof(*(p_observed)), INFINITE)
+#define NTRINGB_UNPARK(p_address) WakeByAddressAll((PVOID)(p_address))
+#endif
+
+#if defined(NTRINGB_WAIT_ON_ADDRESS) && !defined(NTRINGB_PARK_SLICE)
+#ifndef NTRINGB_PARK_SLICE_MS
+#define NTRINGB_PARK_SLICE_MS 1
+#endif
+#define NTRINGB_PARK_SLICE(p_address, p_observed) WaitOnAddress((volatile VOID *)(p_address), (PVOID)(p_observed), sizeof(*(p_observed)), NTRINGB_PARK_SLICE_MS)
+#endif
+
+// Define NTRINGB_COLLECT_STATS to collect statistics of NTRINGB ring-buffer usage into NTRINGB_STATS
+// attached to stream position. Because stream position is local to the thread, statistics
+// are updated without interlocked operations. Enqueue-to-dequeue latency is measured with
+// NTRINGB_STATS_TIMESTAMP(), which is ReadTimeStampCounter() by default, and you can define it
+// for example as KeQueryPerformanceCounter(NULL).QuadPart instead.
+#ifdef NTRINGB_COLLECT_STATS
+
+#ifndef NTRINGB_STATS_TIMESTAMP
+#define NTRINGB_STATS_TIMESTAMP() ((LONG64)ReadTimeStampCounter())
+#endif
+
+// Count of buckets of latency histogram, where bucket k counts latencies in range [2^k, 2^(k+1))
+#define NTRINGB_STATS_HISTOGRAM_SIZE 32
+
+/// <summary>
+/// Statistics of Ring-Buffer usage by one thread
+/// 
+/// Note: wait_count is count of wait iterations in blocking begin functions,
+/// commit_retry_count is count of failed compare-exchange in commit functions,
+/// and max_occupancy is highest count of elements in ring-buffer seen by writer.
+/// Latency of each position is added to histogram once, and latency_pos is last
+/// position, which was added.
+/// </summary>
+typedef struct tagNTRINGB_STATS {
+	LONG64 commit_count;
+	LONG64 wait_count;
+	LONG64 commit_retry_count;
+	LONG max_occupancy;
+	LONG64 latency_pos;
+	LONG64 latency_histogram[NTRINGB_STATS_HISTOGRAM_SIZE];
+} NTRINGB_STATS, *PNTRINGB_STATS;
+
+// Special macros updating statistics attached to stream position
+#define NTRINGB_STATS_COUNT(p_ringb_pos, field) do { if (NULL != (p_ringb_pos)->p_stats) { ++((p_ringb_pos)->p_stats->field); } } while (0)
+#define NTRINGB_STATS_OCCUPANCY(p_ringb_pos) ntringb_stats_occupancy(p_ringb_pos)
+#define NTRINGB_STATS_STAMP(p_ringb_pos) ntringb_stats_stamp(p_ringb_pos)
+#define NTRINGB_STATS_LATENCY(p_ringb_pos) ntringb_stats_latency(p_ringb_pos)
+#else
+#define NTRINGB_STATS_COUNT(p_ringb_pos, field)
+#define NTRINGB_STATS_OCCUPANCY(p_ringb_pos)
+#define NTRINGB_STATS_STAMP(p_ringb_pos)
+#define NTRINGB_STATS_LATENCY(p_ringb_pos)
+#endif
+
+// Define NTRINGB_RECORD_TAP to allow attaching tap to NTRINGB ring-buffer, which copies every
+// element committed by writer into recording ring-buffer, e.g. NTRINGB_SHARED mapped into
+// capture process. Each record is NTRINGB_TAP_HEADER followed by copy of the element. Writer
+// copies element once it is its turn to commit, and before it publishes it, so that elements
+// of commits stopped after ring-buffer was closed are not recorded. Writer never waits for
+// the recording ring-buffer, i.e. elements that don't fit are dropped from recording. Without NTRINGB_RECORD_TAP defined commit
+// functions are unchanged, and with it defined they only check for tap.
+#ifdef NTRINGB_RECORD_TAP
+
+/// <summary>
+/// Header of record in recording ring-buffer
+/// 
+/// Note: pos is position of the element in tapped ring-buffer, and timestamp is
+/// NTRINGB_TIMESTAMP() of commit, so that replay can restore order and timing.
+/// Abandoned element is recorded with NTRINGB_TAP_ABANDONED flag, and without
+/// copy of the element, so that replay can pass over it.
+/// 
+/// Note: sequence is (low part of) position of the record in recording ring-buffer,
+/// which is stored once the record is complete, so that writers publish records
+/// without waiting for each other.
+/// </summary>
+typedef struct tagNTRINGB_TAP_HEADER {
+	LONG64 timestamp;
+	LONG64 pos;
+	LONG flags;
+	LONG sequence;
+} NTRINGB_TAP_HEADER, *PNTRINGB_TAP_HEADER;
+
+// Flag of record of element abandoned with ntringb_abandon_write()
+#define NTRINGB_TAP_ABANDONED 1
+
+// Size of record in recording ring-buffer holding element of element_size
+#define NTRINGB_TAP_RECORD_SIZE(element_size) ((LONG)sizeof(NTRINGB_TAP_HEADER) + (LONG)(element_size))
+
+// Special macro returning pointer to header of record at position in recording ring-buffer of the tap
+#define NTRINGB_TAP_PHEADER(p_tap, pos) \
+	((PNTRINGB_TAP_HEADER)((p_tap)->p_record_buffer + (SIZE_T)((pos) & (p_tap)->record_mask) * (SIZE_T)(p_tap)->record_size))
+
+/// <summary>
+/// Tap of Ring-Buffer
+/// 
+/// Note: tap holds local addresses of the buffer of tapped ring-buffer, and of
+/// recording ring-buffer, and count of elements that were dropped from recording.
+/// Records and elements are indexed only with private copies of the masks, as
+/// recording ring-buffer lives in the mapping, and only its positions are read.
+/// </summary>
+typedef struct tagNTRINGB_TAP {
+	struct tagNTRINGB_STATE volatile *p_recorder;
+	PUCHAR p_record_buffer;
+	PUCHAR p_source_buffer;
+	LONG element_size;
+	LONG record_size;
+	LONG record_count;
+	LONG record_mask;
+	LONG source_mask;
+	volatile LONG drop_count;
+} NTRINGB_TAP, *PNTRINGB_TAP;
+
+// Special macro copying elements being committed into recording ring-buffer
+#define NTRINGB_TAP_COPY(p_ringb_pos, count) do { if (NULL != (p_ringb_pos)->p_local->p_tap) { ntringb_tap_copy((p_ringb_pos), (count)); } } while (0)
+
+// Special macro waiting for turn of writer, and then copying elements being committed, FALSE if commits are stopped
+#define NTRINGB_TAP_RECORD(p_ringb_pos, count) (NULL == (p_ringb_pos)->p_local->p_tap || ntringb_tap_record((p_ringb_pos), (count)))
+#else
+#define NTRINGB_TAP_COPY(p_ringb_pos, count)
+#define NTRINGB_TAP_RECORD(p_ringb_pos, count) TRUE
+#endif
+
+/// <summary>
+/// Local state of Ring-Buffer
+/// 
+/// Note: local state holds pointers and masks, which are valid in one address
+/// space only, so that shared ring-buffer keeps it in its local view, and never
+/// reads it from the mapping. Masks are copies made when pointers are set.
+/// 
+/// Note: p_ready_mask and ready_bit are set when ring-buffer is added to NTRINGB_SET,
+/// and otherwise they are NULL and zero. p_skip_marks is set by ntringb_enable_skip().
+/// With NTRINGB_COLLECT_STATS defined, p_timestamps is set by ntringb_stats_enable_latency().
+/// With NTRINGB_RECORD_TAP defined, p_tap is set by ntringb_tap_attach().
+/// </summary>
+typedef struct tagNTRINGB_LOCAL {
+	LONG64 volatile *p_ready_mask;
+	LONG64 ready_bit;
+	NTRINGB_SEQ volatile *p_skip_marks;
+	LONG skip_mask;
+#ifdef NTRINGB_COLLECT_STATS
+	LONG64 volatile *p_timestamps;
+	LONG timestamp_mask;
+#endif
+#ifdef NTRINGB_RECORD_TAP
+	PNTRINGB_TAP volatile p_tap;
+#endif
+} NTRINGB_LOCAL, *PNTRINGB_LOCAL;
+
+/// <summary>
+/// Ring-Buffer control state
+/// 
+/// Note: control state holds only positions, counters and flags, and no pointers,
+/// so that it is valid at any address and in any address space, which lets shared
+/// ring-buffer place it in the mapping, see NTRINGB_SHARED.
+/// 
+/// Note: with NTRINGB_PADDED defined, producer-side and consumer-side counters
+/// are each on separate cache line, and buffer count and mask are on read-only
+/// cache line.
+/// 
+/// Note: buffer count and mask are here only to construct stream positions,
+/// which index the buffer with their own copies, see NTRINGB_POS.
+/// 
+/// Note: released positions are set only after ring-buffer is closed, when claim
+/// released by blocking begin function cannot be passed over, see ntringb_release_write().
+/// </summary>
+typedef struct tagNTRINGB_STATE {
+	NTRINGB_CACHE_ALIGN NTRINGB_SEQ next_write_pos;
+	NTRINGB_CACHE_ALIGN NTRINGB_SEQ last_write_pos;
+	LONG read_waiters;
+	NTRINGB_CACHE_ALIGN NTRINGB_SEQ next_read_pos;
+	NTRINGB_CACHE_ALIGN NTRINGB_SEQ last_read_pos;
+	LONG write_waiters;
+	NTRINGB_CACHE_ALIGN LONG pow2_buffer_count;
+	LONG pow2_buffer_mask;
+	LONG closed;
+	NTRINGB_SEQ released_write_pos;
+	NTRINGB_SEQ released_read_pos;
+
+} NTRINGB_STATE, *PNTRINGB_STATE;
 
 /// <summary>
 /// Ring-Buffer data structure
 /// 
 /// Note: this is control structure, and buffer itself needs to be allocated
 /// separately by the user. It can be as simple as an array of elements.
+/// 
+/// Note: if you allocate this structure dynamically with NTRINGB_PADDED defined,
+/// then you must align it to NTRINGB_CACHE_LINE_SIZE.
+/// 
+/// Note: local holds state, which is local to one address space, and stream positions
+/// reach it through their own pointer, and not through the control structure.
 /// </summary>
 typedef struct tagNTRINGB {
-	LONG next_write_pos;
-	LONG last_write_pos;
-	LONG next_read_pos;
-	LONG last_read_pos;
-	LONG pow2_buffer_count;
+	NTRINGB_STATE state;
+	NTRINGB_LOCAL local;
 
 } NTRINGB, *PNTRINGB;
 
@@ -60,225 +350,3526 @@ typedef struct tagNTRINGB {
 /// You can have as many threads reading/writing as you like, since we support
 /// MPMC. However keep in mind that multiple-consumers will receive elements
 /// unordered, and also each element can only be read by one consumer, i.e.
-/// we do not support pub-sub, and only queue semantics.
+/// NTRINGB does not support pub-sub, and only queue semantics. For pub-sub
+/// use NTRINGB_BCAST.
 /// 
 /// Note also that both synchronous and asynchronous access can be performed on
 /// same ring-buffer. One thread may be writing synchronously, while other
 /// thread might be reading asynchronously so that it can read multiple
 /// streams (from whichever is ready).
+/// 
+/// Note: stream position holds private copies of buffer count and mask, and
+/// indexes the buffer only with them, so that a corrupted control state of
+/// shared ring-buffer cannot make it index outside of the buffer.
 /// </summary>
 typedef struct tagNTRINGB_POS {
-	NTRINGB volatile *p_ringb;
-	LONG current_pos;
+	NTRINGB_STATE volatile *p_ringb;
+	NTRINGB_LOCAL volatile *p_local;
+	NTRINGB_SEQ current_pos;
+	LONG current_count;
+	LONG pow2_buffer_count;
+	LONG pow2_buffer_mask;
+#ifdef NTRINGB_COLLECT_STATS
+	PNTRINGB_STATS p_stats;
+#endif
 } NTRINGB_POS, *PNTRINGB_POS;
 
+/// <summary>
+/// Wait State
+/// 
+/// Note: each blocking begin function has its own local wait state, which
+/// tracks how long it has been waiting, and what position it has observed.
+/// Timed wait parks only in slices, see NTRINGB_PARK_SLICE.
+/// </summary>
+typedef struct tagNTRINGB_WAIT {
+	NTRINGB_SEQ volatile *p_address;
+	LONG volatile *p_waiters;
+	LONG volatile *p_closed;
+	NTRINGB_SEQ observed;
+	LONG iteration;
+	LONG timed;
+} NTRINGB_WAIT, *PNTRINGB_WAIT;
 
 /// <summary>
-/// Construct Ring-Buffer
+/// Construct Wait State
 /// </summary>
-/// <param name="p_ringb">A pointer to global (or shared) variable holding ring-buffer</param>
-/// <param name="pow2_buffer_count">Total count of elements in the ring-buffer. Must be power of 2!</param>
-void ntringb_init(NTRINGB volatile *p_ringb, LONG pow2_buffer_count) {
-	p_ringb->next_write_pos = -1;
-	p_ringb->last_write_pos = -1;
-	p_ringb->next_read_pos = -1;
-	p_ringb->last_read_pos = -1;
-	p_ringb->pow2_buffer_count = pow2_buffer_count;
+/// <param name="p_wait">A pointer to local variable holding wait state</param>
+/// <param name="p_address">A pointer to position, change of which ends the wait</param>
+/// <param name="p_waiters">A pointer to count of parked threads waiting for change of the position, or NULL not to park</param>
+void ntringb_wait_init(PNTRINGB_WAIT p_wait, NTRINGB_SEQ volatile *p_address, LONG volatile *p_waiters) {
+	p_wait->p_address = p_address;
+	p_wait->p_waiters = p_waiters;
+	p_wait->p_closed = NULL;
+	p_wait->observed = *p_address;
+	p_wait->iteration = 0;
+	p_wait->timed = FALSE;
 }
 
 /// <summary>
-/// Contruct Stream Position in the Ring-Buffer
+/// Make the wait end when ring-buffer is closed
+/// 
+/// Note: closed state is checked after thread is counted as parked, and before
+/// it parks, so that ntringb_close() either sees parked thread and wakes it, or
+/// thread sees closed state and does not park.
 /// </summary>
-/// <param name="p_ringb">A pointer to global (or shared) variable holding ring-buffer</param>
-/// <param name="p_result">A pointer to local variable holding ring-buffer stream position</param>
-void ntringb_pos_init(NTRINGB volatile* p_ringb, PNTRINGB_POS p_result) {
-	p_result->p_ringb = p_ringb;
-	p_result->current_pos = -1;
+/// <param name="p_wait">A pointer to local variable holding wait state</param>
+/// <param name="p_closed">A pointer to closed state of ring-buffer</param>
+void ntringb_wait_closable(PNTRINGB_WAIT p_wait, LONG volatile *p_closed) {
+	p_wait->p_closed = p_closed;
 }
 
 /// <summary>
-/// Tell available space for writing
+/// Make the wait timed, so that it parks only in slices, and caller can check deadline
 /// </summary>
-/// <param name="p_ringb_pos">A pointer to local variable holding ring-buffer stream position</param>
-/// <returns>Count of spaces available</returns>
-LONG ntringb_available_write(PNTRINGB_POS p_ringb_pos) {
-	LONG available = 0;
-
-	available = p_ringb_pos->p_ringb->pow2_buffer_count + p_ringb_pos->p_ringb->last_read_pos - p_ringb_pos->current_pos + 1;
+/// <param name="p_wait">A pointer to local variable holding wait state</param>
+void ntringb_wait_timed(PNTRINGB_WAIT p_wait) {
+	p_wait->timed = TRUE;
+}
 
-	return available;
+/// <summary>
+/// Change position, change of which ends the wait
+/// 
+/// Note: this is for waits that depend on more than one position, e.g. slowest
+/// of many readers. Caller must pass value of the position, with which it has
+/// checked the condition, so that it is safe to park until position changes.
+/// </summary>
+/// <param name="p_wait">A pointer to local variable holding wait state</param>
+/// <param name="p_address">A pointer to position, change of which ends the wait</param>
+/// <param name="observed">Value of the position, with which caller has checked the condition</param>
+void ntringb_wait_retarget(PNTRINGB_WAIT p_wait, NTRINGB_SEQ volatile *p_address, NTRINGB_SEQ observed) {
+	p_wait->p_address = p_address;
+	p_wait->observed = observed;
 }
 
 /// <summary>
-/// Tell available space for reading
+/// Wait one iteration
+/// 
+/// Note: observed position is captured at the end of each iteration, i.e. before
+/// caller checks the condition again. If that check fails on the same position,
+/// then it is safe to park until position changes.
 /// </summary>
-/// <param name="p_ringb_pos">A pointer to local variable holding ring-buffer stream position</param>
-/// <returns>Count of spaces available</returns>
-LONG ntringb_available_read(PNTRINGB_POS p_ringb_pos) {
-	LONG available = 0;
-	
-	available = p_ringb_pos->p_ringb->last_write_pos - p_ringb_pos->current_pos + 1;
-	
-	return available;
+/// <param name="p_wait">A pointer to local variable holding wait state</param>
+void ntringb_wait(PNTRINGB_WAIT p_wait) {
+#ifdef NTRINGB_WAIT_BUSY_SPIN
+	UNREFERENCED_PARAMETER(p_wait);
+	NTRINGB_POLL_BARRIER();
+#else
+	LONG i;
+	LONG backoff;
+
+	if (p_wait->iteration < NTRINGB_WAIT_SPIN_COUNT)
+	{
+		YieldProcessor();
+		++(p_wait->iteration);
+	}
+	else if (p_wait->iteration < NTRINGB_WAIT_SPIN_COUNT + NTRINGB_WAIT_BACKOFF_LIMIT)
+	{
+		backoff = 2L << (p_wait->iteration - NTRINGB_WAIT_SPIN_COUNT);
+		for (i = 0; i != backoff; ++i)
+		{
+			YieldProcessor();
+		}
+		++(p_wait->iteration);
+	}
+	else
+	{
+#ifdef NTRINGB_PARK
+#ifdef NTRINGB_PARK_SLICE
+		if (NULL != p_wait->p_waiters)
+#else
+		if (NULL != p_wait->p_waiters && FALSE == p_wait->timed)
+#endif
+		{
+			InterlockedIncrement(p_wait->p_waiters);
+			if (p_wait->observed == *(p_wait->p_address)
+				&& (NULL == p_wait->p_closed || FALSE == *(p_wait->p_closed)))
+			{
+#ifdef NTRINGB_PARK_SLICE
+				if (FALSE != p_wait->timed)
+				{
+					NTRINGB_PARK_SLICE(p_wait->p_address, &(p_wait->observed));
+				}
+				else
+#endif
+				{
+					NTRINGB_PARK(p_wait->p_address, &(p_wait->observed));
+				}
+			}
+			InterlockedDecrement(p_wait->p_waiters);
+		}
+		else
+#endif
+		{
+			for (i = 0; i != (1L << NTRINGB_WAIT_BACKOFF_LIMIT); ++i)
+			{
+				YieldProcessor();
+			}
+		}
+	}
+
+	p_wait->observed = *(p_wait->p_address);
+#endif
 }
 
 /// <summary>
-/// Begin writing one element
+/// Wake threads parked waiting for change of the position
+/// 
+/// Note: this does nothing unless NTRINGB_PARK is defined, and otherwise it only
+/// calls NTRINGB_UNPARK if there is a parked thread.
 /// </summary>
-/// <param name="p_ringb_pos">A pointer to local variable holding ring-buffer stream position</param>
-/// <returns>Index of the available space</returns>
-LONG ntringb_begin_write(PNTRINGB_POS p_ringb_pos) {
-	LONG buffer_pos = 0;
-	p_ringb_pos->current_pos = InterlockedIncrement(&(p_ringb_pos->p_ringb->next_write_pos));
-	
-	while (ntringb_available_write(p_ringb_pos) < 1)
+/// <param name="p_address">A pointer to position that has changed</param>
+/// <param name="p_waiters">A pointer to count of parked threads waiting for change of the position</param>
+void ntringb_wake(NTRINGB_SEQ volatile *p_address, LONG volatile *p_waiters) {
+#ifdef NTRINGB_PARK
+	// Change of the position must be visible before we check for parked threads
+	MemoryBarrier();
+
+	if (0 != *p_waiters)
 	{
-		MemoryBarrier();
+		NTRINGB_UNPARK(p_address);
 	}
+#else
+	UNREFERENCED_PARAMETER(p_address);
+	UNREFERENCED_PARAMETER(p_waiters);
+#endif
+}
 
-	buffer_pos = p_ringb_pos->current_pos & (p_ringb_pos->p_ringb->pow2_buffer_count - 1);
-	return buffer_pos;
+/// <summary>
+/// Mark ring-buffer as ready in readiness set it belongs to
+/// 
+/// Note: this does nothing unless ring-buffer was added to NTRINGB_SET, and otherwise
+/// it only performs interlocked operation if the bit is not already set.
+/// </summary>
+/// <param name="p_local">A pointer to local state of ring-buffer</param>
+void ntringb_signal_ready(NTRINGB_LOCAL volatile *p_local) {
+	LONG64 volatile *p_ready_mask;
+
+	p_ready_mask = p_local->p_ready_mask;
+
+	if (NULL != p_ready_mask && 0 == (ReadAcquire64(p_ready_mask) & p_local->ready_bit))
+	{
+		InterlockedOr64(p_ready_mask, p_local->ready_bit);
+	}
 }
 
+#ifdef NTRINGB_COLLECT_STATS
 /// <summary>
-/// Begin reading one element
+/// Construct Statistics, and attach them to Stream Position
 /// </summary>
 /// <param name="p_ringb_pos">A pointer to local variable holding ring-buffer stream position</param>
-/// <returns>Index of the ready element</returns>
-LONG ntringb_begin_read(PNTRINGB_POS p_ringb_pos) {
-	LONG buffer_pos = 0;
-	p_ringb_pos->current_pos = InterlockedIncrement(&(p_ringb_pos->p_ringb->next_read_pos));
+/// <param name="p_stats">A pointer to variable holding statistics, which must be used by this thread only</param>
+void ntringb_stats_init(PNTRINGB_POS p_ringb_pos, PNTRINGB_STATS p_stats) {
+	LONG bucket;
 
-	while (ntringb_available_read(p_ringb_pos) < 1)
+	p_stats->commit_count = 0;
+	p_stats->wait_count = 0;
+	p_stats->commit_retry_count = 0;
+	p_stats->max_occupancy = 0;
+	p_stats->latency_pos = -1;
+
+	for (bucket = 0; bucket != NTRINGB_STATS_HISTOGRAM_SIZE; ++bucket)
 	{
-		MemoryBarrier();
+		p_stats->latency_histogram[bucket] = 0;
 	}
 
-	buffer_pos = p_ringb_pos->current_pos & (p_ringb_pos->p_ringb->pow2_buffer_count - 1);
-	return buffer_pos;
+	p_ringb_pos->p_stats = p_stats;
 }
 
 /// <summary>
-/// Commit writing one element
+/// Enable measuring of enqueue-to-dequeue latency
+/// 
+/// Note: each writer stores timestamp of the committed element, and reader adds
+/// its latency to histogram. Call this before any writer starts.
+/// 
+/// Note: timestamps are indexed with mask of pow2_timestamp_count, and not with
+/// mask of the ring-buffer, so that they are never accessed out of bounds.
 /// </summary>
-/// <param name="p_ringb_pos">A pointer to local variable holding ring-buffer stream position</param>
-void ntringb_commit_write(PNTRINGB_POS p_ringb_pos) {
-	LONG last_write_pos;
-	
-	last_write_pos = p_ringb_pos->current_pos - 1;
-	
-	while (last_write_pos != InterlockedCompareExchange(
-		&(p_ringb_pos->p_ringb->last_write_pos),
-		last_write_pos + 1,
-		last_write_pos))
-	{}
+/// <param name="p_ringb">A pointer to global variable holding ring-buffer</param>
+/// <param name="p_timestamps">A pointer to array of pow2_timestamp_count timestamps</param>
+/// <param name="pow2_timestamp_count">Count of timestamps in the array, which should be pow2_buffer_count. Must be power of 2!</param>
+void ntringb_stats_enable_latency(NTRINGB volatile *p_ringb, LONG64 volatile *p_timestamps, LONG pow2_timestamp_count) {
+	p_ringb->local.timestamp_mask = pow2_timestamp_count - 1;
+	p_ringb->local.p_timestamps = p_timestamps;
 }
 
 /// <summary>
-/// Commit reading one element
+/// Update highest count of elements in ring-buffer and count of commits
 /// </summary>
 /// <param name="p_ringb_pos">A pointer to local variable holding ring-buffer stream position</param>
-void ntringb_commit_read(PNTRINGB_POS p_ringb_pos) {
-	LONG last_read_pos;
-	
-	last_read_pos = p_ringb_pos->current_pos - 1;
-	
-	while (last_read_pos != InterlockedCompareExchange(
-		&(p_ringb_pos->p_ringb->last_read_pos),
-		last_read_pos + 1,
-		last_read_pos))
-	{}
-}
+void ntringb_stats_occupancy(PNTRINGB_POS p_ringb_pos) {
+	LONG occupancy;
 
-//
-// Async
-//
+	if (NULL == p_ringb_pos->p_stats)
+	{
+		return;
+	}
+
+	occupancy = (LONG)(p_ringb_pos->current_pos - p_ringb_pos->p_ringb->last_read_pos);
+
+	if (p_ringb_pos->p_stats->max_occupancy < occupancy)
+	{
+		p_ringb_pos->p_stats->max_occupancy = occupancy;
+	}
+
+	++(p_ringb_pos->p_stats->commit_count);
+}
 
 /// <summary>
-/// Begin writing one element
+/// Store timestamp of (last) element being committed by writer
 /// </summary>
 /// <param name="p_ringb_pos">A pointer to local variable holding ring-buffer stream position</param>
-/// <returns>Index of the available space</returns>
-LONG ntringb_poll_begin_write(PNTRINGB_POS p_ringb_pos) {
-	LONG buffer_pos = 0;
-	p_ringb_pos->current_pos = InterlockedIncrement(&(p_ringb_pos->p_ringb->next_write_pos));
-	
-	buffer_pos = p_ringb_pos->current_pos & (p_ringb_pos->p_ringb->pow2_buffer_count - 1);
-	return buffer_pos;
+void ntringb_stats_stamp(PNTRINGB_POS p_ringb_pos) {
+	LONG64 volatile *p_timestamps;
+
+	p_timestamps = p_ringb_pos->p_local->p_timestamps;
+
+	if (NULL != p_timestamps)
+	{
+		p_timestamps[p_ringb_pos->current_pos & p_ringb_pos->p_local->timestamp_mask] = NTRINGB_STATS_TIMESTAMP();
+	}
 }
 
 /// <summary>
-/// Begin reading one element
+/// Add latency of (last) element ready for reader to histogram
 /// </summary>
 /// <param name="p_ringb_pos">A pointer to local variable holding ring-buffer stream position</param>
-/// <returns>Index of the ready element</returns>
-LONG ntringb_poll_begin_read(PNTRINGB_POS p_ringb_pos) {
-	LONG buffer_pos = 0;
-	p_ringb_pos->current_pos = InterlockedIncrement(&(p_ringb_pos->p_ringb->next_read_pos));
+void ntringb_stats_latency(PNTRINGB_POS p_ringb_pos) {
+	LONG64 volatile *p_timestamps;
+	LONG64 latency;
+	ULONG bucket = 0;
 
-	buffer_pos = p_ringb_pos->current_pos & (p_ringb_pos->p_ringb->pow2_buffer_count - 1);
-	return buffer_pos;
+	p_timestamps = p_ringb_pos->p_local->p_timestamps;
+
+	if (NULL == p_timestamps || NULL == p_ringb_pos->p_stats || p_ringb_pos->current_pos == p_ringb_pos->p_stats->latency_pos)
+	{
+		return;
+	}
+
+	p_ringb_pos->p_stats->latency_pos = p_ringb_pos->current_pos;
+	latency = NTRINGB_STATS_TIMESTAMP() - p_timestamps[p_ringb_pos->current_pos & p_ringb_pos->p_local->timestamp_mask];
+
+	// Latency of 2^32 or more is in last bucket, so that 32-bit scan is enough, also on x86
+	if ((LONG64)0xFFFFFFFF < latency)
+	{
+		bucket = NTRINGB_STATS_HISTOGRAM_SIZE - 1;
+	}
+	else if (0 < latency)
+	{
+		BitScanReverse(&bucket, (ULONG)latency);
+	}
+
+	++(p_ringb_pos->p_stats->latency_histogram[bucket]);
 }
+#endif
+
 
 /// <summary>
-/// Tell if space is ready for writing 
+/// Construct Local state of Ring-Buffer
 /// </summary>
-/// <param name="p_ringb_pos">A pointer to local variable holding ring-buffer stream position</param>
-/// <returns>TRUE if space can be written to, FALSE if need to wait, and try again later</returns>
-BOOL ntringb_poll_write_ready(PNTRINGB_POS p_ringb_pos) {
-	LONG available = 0;
-	
-	MemoryBarrier();
+/// <param name="p_local">A pointer to variable holding local state of ring-buffer</param>
+void ntringb_local_init(NTRINGB_LOCAL volatile *p_local) {
+	p_local->p_ready_mask = NULL;
+	p_local->ready_bit = 0;
+	p_local->p_skip_marks = NULL;
+	p_local->skip_mask = 0;
+#ifdef NTRINGB_COLLECT_STATS
+	p_local->p_timestamps = NULL;
+	p_local->timestamp_mask = 0;
+#endif
+#ifdef NTRINGB_RECORD_TAP
+	p_local->p_tap = NULL;
+#endif
+}
 
-	available = ntringb_available_write(p_ringb_pos);
+/// <summary>
+/// Construct Control state of Ring-Buffer
+/// </summary>
+/// <param name="p_state">A pointer to global (or shared) variable holding control state of ring-buffer</param>
+/// <param name="pow2_buffer_count">Total count of elements in the ring-buffer. Must be power of 2!</param>
+void ntringb_state_init(NTRINGB_STATE volatile *p_state, LONG pow2_buffer_count) {
+	p_state->next_write_pos = -1;
+	p_state->last_write_pos = -1;
+	p_state->next_read_pos = -1;
+	p_state->last_read_pos = -1;
+	p_state->read_waiters = 0;
+	p_state->write_waiters = 0;
+	p_state->pow2_buffer_count = pow2_buffer_count;
+	p_state->pow2_buffer_mask = pow2_buffer_count - 1;
+	p_state->closed = FALSE;
+	p_state->released_write_pos = -1;
+	p_state->released_read_pos = -1;
+}
 
-	return (0 < available);
+/// <summary>
+/// Construct Ring-Buffer
+/// </summary>
+/// <param name="p_ringb">A pointer to global (or shared) variable holding ring-buffer</param>
+/// <param name="pow2_buffer_count">Total count of elements in the ring-buffer. Must be power of 2!</param>
+void ntringb_init(NTRINGB volatile *p_ringb, LONG pow2_buffer_count) {
+	ntringb_state_init(&(p_ringb->state), pow2_buffer_count);
+	ntringb_local_init(&(p_ringb->local));
 }
 
 /// <summary>
-/// Tell if element is ready for reading
+/// Contruct Stream Position in the Ring-Buffer
+/// </summary>
+/// <param name="p_ringb">A pointer to global (or shared) variable holding ring-buffer</param>
+/// <param name="p_result">A pointer to local variable holding ring-buffer stream position</param>
+void ntringb_pos_init(NTRINGB volatile* p_ringb, PNTRINGB_POS p_result) {
+	p_result->p_ringb = &(p_ringb->state);
+	p_result->p_local = &(p_ringb->local);
+	p_result->current_pos = -1;
+	p_result->current_count = 0;
+	p_result->pow2_buffer_count = p_ringb->state.pow2_buffer_count;
+	p_result->pow2_buffer_mask = p_ringb->state.pow2_buffer_mask;
+#ifdef NTRINGB_COLLECT_STATS
+	p_result->p_stats = NULL;
+#endif
+}
+
+/// <summary>
+/// Tell available space for writing
 /// </summary>
 /// <param name="p_ringb_pos">A pointer to local variable holding ring-buffer stream position</param>
-/// <returns>TRUE if element can be read from, FALSE if need to wait, and try again later</returns>
-BOOL ntringb_poll_read_ready(PNTRINGB_POS p_ringb_pos) {
+/// <returns>Count of spaces available</returns>
+LONG ntringb_available_write(PNTRINGB_POS p_ringb_pos) {
 	LONG available = 0;
-	
-	MemoryBarrier();
 
-	available = ntringb_available_read(p_ringb_pos);
+	available = (LONG)(p_ringb_pos->pow2_buffer_count
+		+ NTRINGB_READ_ACQUIRE(&(p_ringb_pos->p_ringb->last_read_pos)) - p_ringb_pos->current_pos + 1);
 
-	return (0 < available);
+	return available;
 }
 
 /// <summary>
-/// Try commit writing one element
+/// Tell available space for reading
 /// </summary>
 /// <param name="p_ringb_pos">A pointer to local variable holding ring-buffer stream position</param>
-/// <returns>TRUE if write can be committed, FALSE if need to wait, and try again later</returns>
-BOOL ntringb_poll_commit_write(PNTRINGB_POS p_ringb_pos) {
-	LONG last_write_pos;
+/// <returns>Count of spaces available</returns>
+LONG ntringb_available_read(PNTRINGB_POS p_ringb_pos) {
+	LONG available = 0;
 	
-	last_write_pos = p_ringb_pos->current_pos - 1;
+	available = (LONG)(NTRINGB_READ_ACQUIRE(&(p_ringb_pos->p_ringb->last_write_pos)) - p_ringb_pos->current_pos + 1);
 	
-	return (last_write_pos == InterlockedCompareExchange(
-		&(p_ringb_pos->p_ringb->last_write_pos),
-		last_write_pos + 1,
-		last_write_pos));
+	return available;
 }
 
+#ifdef NTRINGB_RECORD_TAP
 /// <summary>
-/// Try commit reading one element
+/// Advance last write position of recording ring-buffer of the tap over complete records
+/// 
+/// Note: writer that completes record, which is next after last write position,
+/// advances it over all complete records, so that record completed out of order
+/// is published by writer of the record before it. Advance is bounded by count of
+/// records, as sequences are in the mapping.
+/// 
+/// Note: caller must issue full barrier between storing sequence of its last record
+/// and calling this. Otherwise writer of record k could read sequence of record k-1
+/// as incomplete, while writer of record k-1 advances and reads sequence of record k
+/// as incomplete too, as each store can still be in store buffer when the other
+/// thread loads (this is allowed also on x86), and record k would stay unpublished
+/// until some later record is completed.
 /// </summary>
-/// <param name="p_ringb_pos">A pointer to local variable holding ring-buffer stream position</param>
-/// <returns>TRUE if read can be committed, FALSE if need to wait, and try again later</returns>
-BOOL ntringb_poll_commit_read(PNTRINGB_POS p_ringb_pos) {
-	LONG last_read_pos;
-	
-	last_read_pos = p_ringb_pos->current_pos - 1;
-	
-	return (last_read_pos == InterlockedCompareExchange(
-		&(p_ringb_pos->p_ringb->last_read_pos),
-		last_read_pos + 1,
-		last_read_pos));
+/// <param name="p_tap">A pointer to tap</param>
+void ntringb_tap_advance(PNTRINGB_TAP p_tap) {
+	NTRINGB_SEQ last_write_pos;
+	LONG i;
+
+	for (i = 0; i != p_tap->record_count; ++i) {
+		last_write_pos = NTRINGB_READ_ACQUIRE(&(p_tap->p_recorder->last_write_pos));
+
+		// Writer of incomplete record advances once it completes it
+		if ((LONG)(last_write_pos + 1) != ReadAcquire(&(NTRINGB_TAP_PHEADER(p_tap, last_write_pos + 1)->sequence)))
+		{
+			return;
+		}
+
+		NTRINGB_INTERLOCKED_COMPARE_EXCHANGE(&(p_tap->p_recorder->last_write_pos), last_write_pos + 1, last_write_pos);
+	}
 }
 
+/// <summary>
+/// Copy elements being committed by writer into recording ring-buffer of the tap
+/// 
+/// Note: this reserves records for all elements with single compare-exchange, and
+/// if recording ring-buffer doesn't have space, then elements are counted as dropped.
+/// Records are published in order of their reservation, but writer never waits for
+/// records of other writers, see ntringb_tap_advance(). Readers of recording
+/// ring-buffer are not woken, and capture process polls it.
+/// </summary>
+/// <param name="p_ringb_pos">A pointer to local variable holding ring-buffer stream position</param>
+/// <param name="count">Count of elements being committed, last of which is at current position</param>
+void ntringb_tap_copy(PNTRINGB_POS p_ringb_pos, LONG count) {
+	PNTRINGB_TAP p_tap;
+	PNTRINGB_TAP_HEADER p_header;
+	NTRINGB_SEQ volatile *p_skip_marks;
+	NTRINGB_SEQ next_write_pos;
+	NTRINGB_SEQ pos;
+	LONG64 timestamp;
+	LONG i;
+
+	p_tap = p_ringb_pos->p_local->p_tap;
+	p_skip_marks = p_ringb_pos->p_local->p_skip_marks;
+
+	do {
+		next_write_pos = p_tap->p_recorder->next_write_pos;
+
+		if ((LONG)(p_tap->record_count + NTRINGB_READ_ACQUIRE(&(p_tap->p_recorder->last_read_pos)) - next_write_pos - count) < 0)
+		{
+			InterlockedExchangeAdd(&(p_tap->drop_count), count);
+			return;
+		}
+
+	} while (next_write_pos != NTRINGB_INTERLOCKED_COMPARE_EXCHANGE(
+		&(p_tap->p_recorder->next_write_pos),
+		next_write_pos + count,
+		next_write_pos));
+
+	timestamp = NTRINGB_TIMESTAMP();
+
+	for (i = 0; i != count; ++i) {
+		pos = p_ringb_pos->current_pos - count + 1 + i;
+		p_header = NTRINGB_TAP_PHEADER(p_tap, next_write_pos + 1 + i);
+
+		p_header->timestamp = timestamp;
+		p_header->pos = (LONG64)pos;
+
+		if (NULL != p_skip_marks && pos == p_skip_marks[pos & p_ringb_pos->p_local->skip_mask])
+		{
+			p_header->flags = NTRINGB_TAP_ABANDONED;
+		}
+		else
+		{
+			p_header->flags = 0;
+			RtlCopyMemory(p_header + 1, p_tap->p_source_buffer +
+				(SIZE_T)(pos & p_tap->source_mask) * (SIZE_T)p_tap->element_size, p_tap->element_size);
+		}
+
+		// Record is complete
+		WriteRelease(&(p_header->sequence), (LONG)(next_write_pos + 1 + i));
+	}
+
+	// Sequences must be visible before last write position is read, see ntringb_tap_advance()
+	MemoryBarrier();
+
+	ntringb_tap_advance(p_tap);
+}
+#endif
+
+/// <summary>
+/// Tell if commits are stopped at position released after ring-buffer was closed
+/// 
+/// Note: commit functions wait until claims before theirs are committed. Claim
+/// released by blocking begin function, which could not be passed over, is never
+/// committed, and then commits of claims after it return without publishing them.
+/// </summary>
+/// <param name="p_ringb">A pointer to ring-buffer control structure</param>
+/// <param name="p_last_pos">A pointer to last committed position of writers (readers)</param>
+/// <param name="p_released_pos">A pointer to released position of writers (readers)</param>
+/// <returns>TRUE if position after last committed position is never committed, FALSE otherwise</returns>
+BOOL ntringb_commit_stopped(NTRINGB_STATE volatile *p_ringb, NTRINGB_SEQ volatile *p_last_pos, NTRINGB_SEQ volatile *p_released_pos) {
+	if (FALSE == ReadAcquire(&(p_ringb->closed)))
+	{
+		return FALSE;
+	}
+
+	return (NTRINGB_READ_ACQUIRE(p_last_pos) + 1 == NTRINGB_READ_ACQUIRE(p_released_pos));
+}
+
+/// <summary>
+/// Wait until claims before first position are committed
+/// 
+/// Note: waiting thread never parks, as claims before it are committed without waiting.
+/// </summary>
+/// <param name="p_ringb">A pointer to ring-buffer control structure</param>
+/// <param name="p_last_pos">A pointer to last committed position of writers (readers)</param>
+/// <param name="p_released_pos">A pointer to released position of writers (readers)</param>
+/// <param name="first_pos">First position of the claim</param>
+/// <returns>TRUE if it is turn of the claim, FALSE if commits are stopped before it</returns>
+BOOL ntringb_wait_turn(NTRINGB_STATE volatile *p_ringb, NTRINGB_SEQ volatile *p_last_pos, NTRINGB_SEQ volatile *p_released_pos, NTRINGB_SEQ first_pos) {
+	NTRINGB_WAIT wait;
+
+	ntringb_wait_init(&wait, p_last_pos, NULL);
+
+	while (first_pos - 1 != NTRINGB_READ_ACQUIRE(p_last_pos))
+	{
+		if (ntringb_commit_stopped(p_ringb, p_last_pos, p_released_pos))
+		{
+			return FALSE;
+		}
+
+		ntringb_wait(&wait);
+	}
+
+	return TRUE;
+}
+
+#ifdef NTRINGB_RECORD_TAP
+/// <summary>
+/// Wait for turn of writer, and then copy elements being committed into recording ring-buffer of the tap
+/// 
+/// Note: element is recorded only once commit cannot be stopped, so that recording
+/// holds only elements that readers of tapped ring-buffer see. Once it is turn of
+/// the writer, then its compare-exchange cannot fail.
+/// </summary>
+/// <param name="p_ringb_pos">A pointer to local variable holding ring-buffer stream position</param>
+/// <param name="count">Count of elements being committed, last of which is at current position</param>
+/// <returns>TRUE if elements were copied (or dropped from recording), FALSE if commits are stopped before them</returns>
+BOOL ntringb_tap_record(PNTRINGB_POS p_ringb_pos, LONG count) {
+	if (FALSE == ntringb_wait_turn(p_ringb_pos->p_ringb, &(p_ringb_pos->p_ringb->last_write_pos),
+		&(p_ringb_pos->p_ringb->released_write_pos), p_ringb_pos->current_pos - count + 1))
+	{
+		return FALSE;
+	}
+
+	ntringb_tap_copy(p_ringb_pos, count);
+	return TRUE;
+}
+#endif
+
+/// <summary>
+/// Release space claimed by blocking begin function, which returns NTRINGB_CLOSED_POS
+/// 
+/// Note: with skip enabled space is abandoned, and readers pass over it, so that
+/// writers after this one can still commit. Space is not free, so that its mark
+/// can only be set if readers have passed over element before it. Otherwise, and
+/// without skip, commits are stopped at released position.
+/// </summary>
+/// <param name="p_ringb_pos">A pointer to local variable holding ring-buffer stream position</param>
+/// <param name="count">Count of positions claimed, last of which is at current position</param>
+void ntringb_release_write(PNTRINGB_POS p_ringb_pos, LONG count) {
+	NTRINGB_SEQ volatile *p_skip_marks;
+	NTRINGB_SEQ first_pos;
+	NTRINGB_SEQ pos;
+
+	first_pos = p_ringb_pos->current_pos - count + 1;
+
+	if (FALSE == ntringb_wait_turn(p_ringb_pos->p_ringb, &(p_ringb_pos->p_ringb->last_write_pos),
+		&(p_ringb_pos->p_ringb->released_write_pos), first_pos))
+	{
+		return;
+	}
+
+	p_skip_marks = p_ringb_pos->p_local->p_skip_marks;
+
+	if (NULL != p_skip_marks)
+	{
+		for (pos = first_pos; pos != p_ringb_pos->current_pos + 1; ++pos) {
+			if (pos - p_ringb_pos->pow2_buffer_count == p_skip_marks[pos & p_ringb_pos->p_local->skip_mask])
+			{
+				break;
+			}
+		}
+
+		if (pos == p_ringb_pos->current_pos + 1)
+		{
+			for (pos = first_pos; pos != p_ringb_pos->current_pos + 1; ++pos) {
+				p_skip_marks[pos & p_ringb_pos->p_local->skip_mask] = pos;
+			}
+
+			NTRINGB_TAP_COPY(p_ringb_pos, count);
+
+			// This is turn of the claim, so that compare-exchange cannot fail
+			NTRINGB_INTERLOCKED_COMPARE_EXCHANGE(&(p_ringb_pos->p_ringb->last_write_pos), p_ringb_pos->current_pos, first_pos - 1);
+
+			ntringb_wake(&(p_ringb_pos->p_ringb->last_write_pos), &(p_ringb_pos->p_ringb->read_waiters));
+			ntringb_signal_ready(p_ringb_pos->p_local);
+			return;
+		}
+	}
+
+	NTRINGB_WRITE_RELEASE(&(p_ringb_pos->p_ringb->released_write_pos), first_pos);
+}
+
+/// <summary>
+/// Release element claimed by blocking begin function, which returns NTRINGB_CLOSED_POS
+/// 
+/// Note: element may still be written after it is released, so that its space
+/// is never freed, and commits of readers are stopped at released position.
+/// </summary>
+/// <param name="p_ringb_pos">A pointer to local variable holding ring-buffer stream position</param>
+/// <param name="count">Count of positions claimed, last of which is at current position</param>
+void ntringb_release_read(PNTRINGB_POS p_ringb_pos, LONG count) {
+	NTRINGB_SEQ first_pos;
+
+	first_pos = p_ringb_pos->current_pos - count + 1;
+
+	if (FALSE != ntringb_wait_turn(p_ringb_pos->p_ringb, &(p_ringb_pos->p_ringb->last_read_pos),
+		&(p_ringb_pos->p_ringb->released_read_pos), first_pos))
+	{
+		NTRINGB_WRITE_RELEASE(&(p_ringb_pos->p_ringb->released_read_pos), first_pos);
+	}
+}
+
+/// <summary>
+/// Begin writing one element
+/// </summary>
+/// <param name="p_ringb_pos">A pointer to local variable holding ring-buffer stream position</param>
+/// <returns>Index of the available space, or NTRINGB_CLOSED_POS if ring-buffer was closed while waiting</returns>
+LONG ntringb_begin_write(PNTRINGB_POS p_ringb_pos) {
+	NTRINGB_WAIT wait;
+	LONG buffer_pos = 0;
+	p_ringb_pos->current_pos = NTRINGB_INTERLOCKED_INCREMENT(&(p_ringb_pos->p_ringb->next_write_pos));
+	
+	ntringb_wait_init(&wait, &(p_ringb_pos->p_ringb->last_read_pos), &(p_ringb_pos->p_ringb->write_waiters));
+	ntringb_wait_closable(&wait, &(p_ringb_pos->p_ringb->closed));
+
+	while (ntringb_available_write(p_ringb_pos) < 1)
+	{
+		if (FALSE != ReadAcquire(&(p_ringb_pos->p_ringb->closed)))
+		{
+			ntringb_release_write(p_ringb_pos, 1);
+			return NTRINGB_CLOSED_POS;
+		}
+
+		ntringb_wait(&wait);
+		NTRINGB_STATS_COUNT(p_ringb_pos, wait_count);
+	}
+
+	buffer_pos = (LONG)(p_ringb_pos->current_pos & p_ringb_pos->pow2_buffer_mask);
+	return buffer_pos;
+}
+
+/// <summary>
+/// Begin reading one element
+/// </summary>
+/// <param name="p_ringb_pos">A pointer to local variable holding ring-buffer stream position</param>
+/// <returns>Index of the ready element, or NTRINGB_CLOSED_POS if ring-buffer was closed while waiting</returns>
+LONG ntringb_begin_read(PNTRINGB_POS p_ringb_pos) {
+	NTRINGB_WAIT wait;
+	LONG buffer_pos = 0;
+	p_ringb_pos->current_pos = NTRINGB_INTERLOCKED_INCREMENT(&(p_ringb_pos->p_ringb->next_read_pos));
+
+	ntringb_wait_init(&wait, &(p_ringb_pos->p_ringb->last_write_pos), &(p_ringb_pos->p_ringb->read_waiters));
+	ntringb_wait_closable(&wait, &(p_ringb_pos->p_ringb->closed));
+
+	while (ntringb_available_read(p_ringb_pos) < 1)
+	{
+		// Elements committed before ring-buffer was closed are visible once closed state is
+		if (FALSE != ReadAcquire(&(p_ringb_pos->p_ringb->closed)) && ntringb_available_read(p_ringb_pos) < 1)
+		{
+			ntringb_release_read(p_ringb_pos, 1);
+			return NTRINGB_CLOSED_POS;
+		}
+
+		ntringb_wait(&wait);
+		NTRINGB_STATS_COUNT(p_ringb_pos, wait_count);
+	}
+
+	NTRINGB_STATS_LATENCY(p_ringb_pos);
+
+	buffer_pos = (LONG)(p_ringb_pos->current_pos & p_ringb_pos->pow2_buffer_mask);
+	return buffer_pos;
+}
+
+/// <summary>
+/// Commit writing one element
+/// </summary>
+/// <param name="p_ringb_pos">A pointer to local variable holding ring-buffer stream position</param>
+void ntringb_commit_write(PNTRINGB_POS p_ringb_pos) {
+	NTRINGB_SEQ last_write_pos;
+	
+	last_write_pos = p_ringb_pos->current_pos - 1;
+	
+	NTRINGB_STATS_STAMP(p_ringb_pos);
+
+	if (!NTRINGB_TAP_RECORD(p_ringb_pos, 1))
+	{
+		return;
+	}
+
+	while (last_write_pos != NTRINGB_INTERLOCKED_COMPARE_EXCHANGE(
+		&(p_ringb_pos->p_ringb->last_write_pos),
+		last_write_pos + 1,
+		last_write_pos))
+	{
+		if (ntringb_commit_stopped(p_ringb_pos->p_ringb, &(p_ringb_pos->p_ringb->last_write_pos), &(p_ringb_pos->p_ringb->released_write_pos)))
+		{
+			return;
+		}
+
+		NTRINGB_STATS_COUNT(p_ringb_pos, commit_retry_count);
+	}
+
+	ntringb_wake(&(p_ringb_pos->p_ringb->last_write_pos), &(p_ringb_pos->p_ringb->read_waiters));
+	ntringb_signal_ready(p_ringb_pos->p_local);
+	NTRINGB_STATS_OCCUPANCY(p_ringb_pos);
+}
+
+/// <summary>
+/// Commit reading one element
+/// </summary>
+/// <param name="p_ringb_pos">A pointer to local variable holding ring-buffer stream position</param>
+void ntringb_commit_read(PNTRINGB_POS p_ringb_pos) {
+	NTRINGB_SEQ last_read_pos;
+	
+	last_read_pos = p_ringb_pos->current_pos - 1;
+	
+	while (last_read_pos != NTRINGB_INTERLOCKED_COMPARE_EXCHANGE(
+		&(p_ringb_pos->p_ringb->last_read_pos),
+		last_read_pos + 1,
+		last_read_pos))
+	{
+		if (ntringb_commit_stopped(p_ringb_pos->p_ringb, &(p_ringb_pos->p_ringb->last_read_pos), &(p_ringb_pos->p_ringb->released_read_pos)))
+		{
+			return;
+		}
+
+		NTRINGB_STATS_COUNT(p_ringb_pos, commit_retry_count);
+	}
+
+	ntringb_wake(&(p_ringb_pos->p_ringb->last_read_pos), &(p_ringb_pos->p_ringb->write_waiters));
+	NTRINGB_STATS_COUNT(p_ringb_pos, commit_count);
+}
+
+//
+// Batch
+//
+// Note: batch functions reserve and publish a contiguous range of elements with
+// single interlocked operation. The range may wrap around the end of the buffer,
+// in which case the first part of the range starts at returned index, and the
+// second part starts at index zero. Stream position tracks last element of the
+// range, so poll functions can be used to wait for the whole range.
+//
+
+/// <summary>
+/// Begin writing multiple elements
+/// </summary>
+/// <param name="p_ringb_pos">A pointer to local variable holding ring-buffer stream position</param>
+/// <param name="count">Count of elements to write. Must be less than half of the buffer count!</param>
+/// <param name="p_contiguous_count">A pointer to variable receiving count of spaces available at returned index before buffer wraps around</param>
+/// <returns>Index of the first available space, or NTRINGB_CLOSED_POS if ring-buffer was closed while waiting</returns>
+LONG ntringb_begin_write_n(PNTRINGB_POS p_ringb_pos, LONG count, PLONG p_contiguous_count) {
+	NTRINGB_WAIT wait;
+	LONG buffer_pos = 0;
+	LONG contiguous_count = 0;
+	p_ringb_pos->current_pos = NTRINGB_INTERLOCKED_EXCHANGE_ADD(&(p_ringb_pos->p_ringb->next_write_pos), count) + count;
+	p_ringb_pos->current_count = count;
+
+	ntringb_wait_init(&wait, &(p_ringb_pos->p_ringb->last_read_pos), &(p_ringb_pos->p_ringb->write_waiters));
+	ntringb_wait_closable(&wait, &(p_ringb_pos->p_ringb->closed));
+
+	while (ntringb_available_write(p_ringb_pos) < 1)
+	{
+		if (FALSE != ReadAcquire(&(p_ringb_pos->p_ringb->closed)))
+		{
+			ntringb_release_write(p_ringb_pos, count);
+			*p_contiguous_count = 0;
+			return NTRINGB_CLOSED_POS;
+		}
+
+		ntringb_wait(&wait);
+		NTRINGB_STATS_COUNT(p_ringb_pos, wait_count);
+	}
+
+	buffer_pos = (LONG)((p_ringb_pos->current_pos - count + 1) & p_ringb_pos->pow2_buffer_mask);
+	contiguous_count = p_ringb_pos->pow2_buffer_count - buffer_pos;
+	*p_contiguous_count = (count < contiguous_count) ? count : contiguous_count;
+	return buffer_pos;
+}
+
+/// <summary>
+/// Begin reading multiple elements
+/// </summary>
+/// <param name="p_ringb_pos">A pointer to local variable holding ring-buffer stream position</param>
+/// <param name="count">Count of elements to read. Must be less than half of the buffer count!</param>
+/// <param name="p_contiguous_count">A pointer to variable receiving count of elements ready at returned index before buffer wraps around</param>
+/// <returns>Index of the first ready element, or NTRINGB_CLOSED_POS if ring-buffer was closed while waiting</returns>
+LONG ntringb_begin_read_n(PNTRINGB_POS p_ringb_pos, LONG count, PLONG p_contiguous_count) {
+	NTRINGB_WAIT wait;
+	LONG buffer_pos = 0;
+	LONG contiguous_count = 0;
+	p_ringb_pos->current_pos = NTRINGB_INTERLOCKED_EXCHANGE_ADD(&(p_ringb_pos->p_ringb->next_read_pos), count) + count;
+	p_ringb_pos->current_count = count;
+
+	ntringb_wait_init(&wait, &(p_ringb_pos->p_ringb->last_write_pos), &(p_ringb_pos->p_ringb->read_waiters));
+	ntringb_wait_closable(&wait, &(p_ringb_pos->p_ringb->closed));
+
+	while (ntringb_available_read(p_ringb_pos) < 1)
+	{
+		// Elements committed before ring-buffer was closed are visible once closed state is
+		if (FALSE != ReadAcquire(&(p_ringb_pos->p_ringb->closed)) && ntringb_available_read(p_ringb_pos) < 1)
+		{
+			ntringb_release_read(p_ringb_pos, count);
+			*p_contiguous_count = 0;
+			return NTRINGB_CLOSED_POS;
+		}
+
+		ntringb_wait(&wait);
+		NTRINGB_STATS_COUNT(p_ringb_pos, wait_count);
+	}
+
+	NTRINGB_STATS_LATENCY(p_ringb_pos);
+
+	buffer_pos = (LONG)((p_ringb_pos->current_pos - count + 1) & p_ringb_pos->pow2_buffer_mask);
+	contiguous_count = p_ringb_pos->pow2_buffer_count - buffer_pos;
+	*p_contiguous_count = (count < contiguous_count) ? count : contiguous_count;
+	return buffer_pos;
+}
+
+/// <summary>
+/// Commit writing multiple elements
+/// </summary>
+/// <param name="p_ringb_pos">A pointer to local variable holding ring-buffer stream position</param>
+void ntringb_commit_write_n(PNTRINGB_POS p_ringb_pos) {
+	NTRINGB_SEQ last_write_pos;
+
+	last_write_pos = p_ringb_pos->current_pos - p_ringb_pos->current_count;
+
+	NTRINGB_STATS_STAMP(p_ringb_pos);
+
+	if (!NTRINGB_TAP_RECORD(p_ringb_pos, p_ringb_pos->current_count))
+	{
+		return;
+	}
+
+	while (last_write_pos != NTRINGB_INTERLOCKED_COMPARE_EXCHANGE(
+		&(p_ringb_pos->p_ringb->last_write_pos),
+		p_ringb_pos->current_pos,
+		last_write_pos))
+	{
+		if (ntringb_commit_stopped(p_ringb_pos->p_ringb, &(p_ringb_pos->p_ringb->last_write_pos), &(p_ringb_pos->p_ringb->released_write_pos)))
+		{
+			return;
+		}
+
+		NTRINGB_STATS_COUNT(p_ringb_pos, commit_retry_count);
+	}
+
+	ntringb_wake(&(p_ringb_pos->p_ringb->last_write_pos), &(p_ringb_pos->p_ringb->read_waiters));
+	ntringb_signal_ready(p_ringb_pos->p_local);
+	NTRINGB_STATS_OCCUPANCY(p_ringb_pos);
+}
+
+/// <summary>
+/// Commit reading multiple elements
+/// </summary>
+/// <param name="p_ringb_pos">A pointer to local variable holding ring-buffer stream position</param>
+void ntringb_commit_read_n(PNTRINGB_POS p_ringb_pos) {
+	NTRINGB_SEQ last_read_pos;
+
+	last_read_pos = p_ringb_pos->current_pos - p_ringb_pos->current_count;
+
+	while (last_read_pos != NTRINGB_INTERLOCKED_COMPARE_EXCHANGE(
+		&(p_ringb_pos->p_ringb->last_read_pos),
+		p_ringb_pos->current_pos,
+		last_read_pos))
+	{
+		if (ntringb_commit_stopped(p_ringb_pos->p_ringb, &(p_ringb_pos->p_ringb->last_read_pos), &(p_ringb_pos->p_ringb->released_read_pos)))
+		{
+			return;
+		}
+
+		NTRINGB_STATS_COUNT(p_ringb_pos, commit_retry_count);
+	}
+
+	ntringb_wake(&(p_ringb_pos->p_ringb->last_read_pos), &(p_ringb_pos->p_ringb->write_waiters));
+	NTRINGB_STATS_COUNT(p_ringb_pos, commit_count);
+}
+
+/// <summary>
+/// Try begin reading up to max_count elements, without reserving elements unless they are ready
+/// 
+/// Note: this reserves as many elements as are committed and not yet reserved,
+/// up to max_count, e.g. to refill NTRINGB_DEQUE of the worker with single
+/// interlocked operation. Commit with ntringb_commit_read_n().
+/// </summary>
+/// <param name="p_ringb_pos">A pointer to local variable holding ring-buffer stream position</param>
+/// <param name="max_count">Maximum count of elements to read</param>
+/// <param name="p_buffer_pos">A pointer to variable receiving index of the first ready element</param>
+/// <param name="p_contiguous_count">A pointer to variable receiving count of elements ready at returned index before buffer wraps around</param>
+/// <returns>Count of elements reserved, or zero if ring-buffer is empty, and try again later</returns>
+LONG ntringb_try_begin_read_n(PNTRINGB_POS p_ringb_pos, LONG max_count, PLONG p_buffer_pos, PLONG p_contiguous_count) {
+	NTRINGB_SEQ next_read_pos;
+	LONG count = 0;
+	LONG buffer_pos = 0;
+	LONG contiguous_count = 0;
+
+	do {
+		next_read_pos = p_ringb_pos->p_ringb->next_read_pos;
+		p_ringb_pos->current_pos = next_read_pos + 1;
+
+		count = ntringb_available_read(p_ringb_pos);
+
+		if (count < 1)
+		{
+			return 0;
+		}
+
+		if (max_count < count)
+		{
+			count = max_count;
+		}
+
+	} while (next_read_pos != NTRINGB_INTERLOCKED_COMPARE_EXCHANGE(
+		&(p_ringb_pos->p_ringb->next_read_pos),
+		next_read_pos + count,
+		next_read_pos));
+
+	p_ringb_pos->current_pos = next_read_pos + count;
+	p_ringb_pos->current_count = count;
+
+	NTRINGB_STATS_LATENCY(p_ringb_pos);
+
+	buffer_pos = (LONG)((next_read_pos + 1) & p_ringb_pos->pow2_buffer_mask);
+	contiguous_count = p_ringb_pos->pow2_buffer_count - buffer_pos;
+	*p_buffer_pos = buffer_pos;
+	*p_contiguous_count = (count < contiguous_count) ? count : contiguous_count;
+	return count;
+}
+
+//
+// Async
+//
+
+/// <summary>
+/// Begin writing one element
+/// </summary>
+/// <param name="p_ringb_pos">A pointer to local variable holding ring-buffer stream position</param>
+/// <returns>Index of the available space</returns>
+LONG ntringb_poll_begin_write(PNTRINGB_POS p_ringb_pos) {
+	LONG buffer_pos = 0;
+	p_ringb_pos->current_pos = NTRINGB_INTERLOCKED_INCREMENT(&(p_ringb_pos->p_ringb->next_write_pos));
+	
+	buffer_pos = (LONG)(p_ringb_pos->current_pos & p_ringb_pos->pow2_buffer_mask);
+	return buffer_pos;
+}
+
+/// <summary>
+/// Begin reading one element
+/// </summary>
+/// <param name="p_ringb_pos">A pointer to local variable holding ring-buffer stream position</param>
+/// <returns>Index of the ready element</returns>
+LONG ntringb_poll_begin_read(PNTRINGB_POS p_ringb_pos) {
+	LONG buffer_pos = 0;
+	p_ringb_pos->current_pos = NTRINGB_INTERLOCKED_INCREMENT(&(p_ringb_pos->p_ringb->next_read_pos));
+
+	buffer_pos = (LONG)(p_ringb_pos->current_pos & p_ringb_pos->pow2_buffer_mask);
+	return buffer_pos;
+}
+
+/// <summary>
+/// Tell if space is ready for writing 
+/// </summary>
+/// <param name="p_ringb_pos">A pointer to local variable holding ring-buffer stream position</param>
+/// <returns>TRUE if space can be written to, FALSE if need to wait, and try again later</returns>
+BOOL ntringb_poll_write_ready(PNTRINGB_POS p_ringb_pos) {
+	LONG available = 0;
+	
+	NTRINGB_POLL_BARRIER();
+
+	available = ntringb_available_write(p_ringb_pos);
+
+	return (0 < available);
+}
+
+/// <summary>
+/// Tell if element is ready for reading
+/// </summary>
+/// <param name="p_ringb_pos">A pointer to local variable holding ring-buffer stream position</param>
+/// <returns>TRUE if element can be read from, FALSE if need to wait, and try again later</returns>
+BOOL ntringb_poll_read_ready(PNTRINGB_POS p_ringb_pos) {
+	LONG available = 0;
+	
+	NTRINGB_POLL_BARRIER();
+
+	available = ntringb_available_read(p_ringb_pos);
+
+	return (0 < available);
+}
+
+/// <summary>
+/// Try commit writing one element
+/// </summary>
+/// <param name="p_ringb_pos">A pointer to local variable holding ring-buffer stream position</param>
+/// <returns>TRUE if write was committed (or dropped, as commits are stopped after ring-buffer was closed), FALSE if need to wait, and try again later</returns>
+BOOL ntringb_poll_commit_write(PNTRINGB_POS p_ringb_pos) {
+	NTRINGB_SEQ last_write_pos;
+	
+	last_write_pos = p_ringb_pos->current_pos - 1;
+	
+	NTRINGB_STATS_STAMP(p_ringb_pos);
+
+#ifdef NTRINGB_RECORD_TAP
+	// Element must be copied only once, so wait for turn of this writer first,
+	// and then compare-exchange cannot fail
+	if (last_write_pos != NTRINGB_READ_ACQUIRE(&(p_ringb_pos->p_ringb->last_write_pos)))
+	{
+		NTRINGB_STATS_COUNT(p_ringb_pos, commit_retry_count);
+		return ntringb_commit_stopped(p_ringb_pos->p_ringb, &(p_ringb_pos->p_ringb->last_write_pos), &(p_ringb_pos->p_ringb->released_write_pos));
+	}
+
+	NTRINGB_TAP_COPY(p_ringb_pos, 1);
+#endif
+
+	if (last_write_pos != NTRINGB_INTERLOCKED_COMPARE_EXCHANGE(
+		&(p_ringb_pos->p_ringb->last_write_pos),
+		last_write_pos + 1,
+		last_write_pos))
+	{
+		NTRINGB_STATS_COUNT(p_ringb_pos, commit_retry_count);
+		return ntringb_commit_stopped(p_ringb_pos->p_ringb, &(p_ringb_pos->p_ringb->last_write_pos), &(p_ringb_pos->p_ringb->released_write_pos));
+	}
+
+	ntringb_wake(&(p_ringb_pos->p_ringb->last_write_pos), &(p_ringb_pos->p_ringb->read_waiters));
+	ntringb_signal_ready(p_ringb_pos->p_local);
+	NTRINGB_STATS_OCCUPANCY(p_ringb_pos);
+	return TRUE;
+}
+
+/// <summary>
+/// Try commit reading one element
+/// </summary>
+/// <param name="p_ringb_pos">A pointer to local variable holding ring-buffer stream position</param>
+/// <returns>TRUE if read was committed (or dropped, as commits are stopped after ring-buffer was closed), FALSE if need to wait, and try again later</returns>
+BOOL ntringb_poll_commit_read(PNTRINGB_POS p_ringb_pos) {
+	NTRINGB_SEQ last_read_pos;
+	
+	last_read_pos = p_ringb_pos->current_pos - 1;
+
+	NTRINGB_STATS_LATENCY(p_ringb_pos);
+	
+	if (last_read_pos != NTRINGB_INTERLOCKED_COMPARE_EXCHANGE(
+		&(p_ringb_pos->p_ringb->last_read_pos),
+		last_read_pos + 1,
+		last_read_pos))
+	{
+		NTRINGB_STATS_COUNT(p_ringb_pos, commit_retry_count);
+		return ntringb_commit_stopped(p_ringb_pos->p_ringb, &(p_ringb_pos->p_ringb->last_read_pos), &(p_ringb_pos->p_ringb->released_read_pos));
+	}
+
+	ntringb_wake(&(p_ringb_pos->p_ringb->last_read_pos), &(p_ringb_pos->p_ringb->write_waiters));
+	NTRINGB_STATS_COUNT(p_ringb_pos, commit_count);
+	return TRUE;
+}
+
+/// <summary>
+/// Try begin writing one element, without reserving space unless it is available
+/// 
+/// Note: unlike ntringb_poll_begin_write() this does not reserve position up front,
+/// so thread that polls many ring-buffers does not accumulate outstanding
+/// reservations on idle ring-buffers. Commit with ntringb_commit_write() or
+/// ntringb_poll_commit_write().
+/// </summary>
+/// <param name="p_ringb_pos">A pointer to local variable holding ring-buffer stream position</param>
+/// <param name="p_buffer_pos">A pointer to variable receiving index of the available space</param>
+/// <returns>TRUE if space was reserved, FALSE if ring-buffer is full, and try again later</returns>
+BOOL ntringb_try_begin_write(PNTRINGB_POS p_ringb_pos, PLONG p_buffer_pos) {
+	NTRINGB_SEQ next_write_pos;
+
+	do {
+		next_write_pos = p_ringb_pos->p_ringb->next_write_pos;
+		p_ringb_pos->current_pos = next_write_pos + 1;
+
+		if (ntringb_available_write(p_ringb_pos) < 1)
+		{
+			return FALSE;
+		}
+
+	} while (next_write_pos != NTRINGB_INTERLOCKED_COMPARE_EXCHANGE(
+		&(p_ringb_pos->p_ringb->next_write_pos),
+		next_write_pos + 1,
+		next_write_pos));
+
+	*p_buffer_pos = (LONG)(p_ringb_pos->current_pos & p_ringb_pos->pow2_buffer_mask);
+	return TRUE;
+}
+
+/// <summary>
+/// Try begin reading one element, without reserving element unless it is ready
+/// 
+/// Note: unlike ntringb_poll_begin_read() this does not reserve position up front,
+/// so thread that polls many ring-buffers does not accumulate outstanding
+/// reservations on idle ring-buffers. Commit with ntringb_commit_read() or
+/// ntringb_poll_commit_read().
+/// </summary>
+/// <param name="p_ringb_pos">A pointer to local variable holding ring-buffer stream position</param>
+/// <param name="p_buffer_pos">A pointer to variable receiving index of the ready element</param>
+/// <returns>TRUE if element was reserved, FALSE if ring-buffer is empty, and try again later</returns>
+BOOL ntringb_try_begin_read(PNTRINGB_POS p_ringb_pos, PLONG p_buffer_pos) {
+	NTRINGB_SEQ next_read_pos;
+
+	do {
+		next_read_pos = p_ringb_pos->p_ringb->next_read_pos;
+		p_ringb_pos->current_pos = next_read_pos + 1;
+
+		if (ntringb_available_read(p_ringb_pos) < 1)
+		{
+			return FALSE;
+		}
+
+	} while (next_read_pos != NTRINGB_INTERLOCKED_COMPARE_EXCHANGE(
+		&(p_ringb_pos->p_ringb->next_read_pos),
+		next_read_pos + 1,
+		next_read_pos));
+
+	NTRINGB_STATS_LATENCY(p_ringb_pos);
+
+	*p_buffer_pos = (LONG)(p_ringb_pos->current_pos & p_ringb_pos->pow2_buffer_mask);
+	return TRUE;
+}
+
+//
+// Timed
+//
+// Note: timed begin functions claim element only once it is available, so that
+// on timeout nothing needs to be released. Closed ring-buffer makes them return
+// NTRINGB_WAIT_CLOSED, where readers first drain elements that were committed.
+// Blocking begin functions return NTRINGB_CLOSED_POS instead of waiting once
+// ring-buffer is closed, and they release space or element they have claimed
+// first, so that claims after theirs can still be committed. Released space is
+// abandoned if skip is enabled. Otherwise commits are stopped at released position,
+// i.e. later commits return without publishing, and elements committed after
+// ring-buffer was closed may be lost. Release waits for claims before it, so that
+// poll functions, which don't see closed state, must release their claim with
+// ntringb_release_write() (ntringb_release_read()) once ring-buffer is closed.
+// Writer that has claimed space, and cannot fill it, can abandon it, and readers
+// pass over it.
+//
+
+/// <summary>
+/// Close control state of ring-buffer, and wake readers and writers waiting on it
+/// </summary>
+/// <param name="p_state">A pointer to control state of ring-buffer</param>
+void ntringb_state_close(NTRINGB_STATE volatile *p_state) {
+	InterlockedExchange(&(p_state->closed), TRUE);
+
+	ntringb_wake(&(p_state->last_write_pos), &(p_state->read_waiters));
+	ntringb_wake(&(p_state->last_read_pos), &(p_state->write_waiters));
+}
+
+/// <summary>
+/// Close ring-buffer, so that timed begin functions return NTRINGB_WAIT_CLOSED,
+/// and blocking begin functions that would wait return NTRINGB_CLOSED_POS
+/// </summary>
+/// <param name="p_ringb">A pointer to ring-buffer control structure</param>
+void ntringb_close(NTRINGB volatile *p_ringb) {
+	ntringb_state_close(&(p_ringb->state));
+}
+
+/// <summary>
+/// Tell if ring-buffer was closed
+/// </summary>
+/// <param name="p_ringb">A pointer to ring-buffer control structure</param>
+/// <returns>TRUE if ring-buffer was closed, FALSE otherwise</returns>
+BOOL ntringb_is_closed(NTRINGB volatile *p_ringb) {
+	return (FALSE != ReadAcquire(&(p_ringb->state.closed)));
+}
+
+/// <summary>
+/// Enable abandoning of claimed space
+/// 
+/// Note: must be called before ring-buffer is used by other threads.
+/// </summary>
+/// <param name="p_ringb">A pointer to ring-buffer control structure</param>
+/// <param name="p_skip_marks">A pointer to array of pow2_buffer_count positions</param>
+void ntringb_enable_skip(NTRINGB volatile *p_ringb, NTRINGB_SEQ volatile *p_skip_marks) {
+	LONG i;
+
+	// Mark of each element must differ from any position that maps to that element
+	for (i = 0; i != p_ringb->state.pow2_buffer_count; ++i)
+	{
+		p_skip_marks[i] = (NTRINGB_SEQ)i - 1;
+	}
+
+	p_ringb->local.skip_mask = p_ringb->state.pow2_buffer_mask;
+	p_ringb->local.p_skip_marks = p_skip_marks;
+}
+
+/// <summary>
+/// Abandon space claimed with begin function, and commit it without element
+/// 
+/// Note: skip must be enabled with ntringb_enable_skip().
+/// </summary>
+/// <param name="p_ringb_pos">A pointer to local variable holding ring-buffer stream position</param>
+void ntringb_abandon_write(PNTRINGB_POS p_ringb_pos) {
+	p_ringb_pos->p_local->p_skip_marks[p_ringb_pos->current_pos & p_ringb_pos->p_local->skip_mask] = p_ringb_pos->current_pos;
+
+	ntringb_commit_write(p_ringb_pos);
+}
+
+/// <summary>
+/// Pass over abandoned element
+/// 
+/// Note: call this after blocking or poll begin read function. If element was
+/// abandoned, then read is committed, and caller must begin reading again.
+/// </summary>
+/// <param name="p_ringb_pos">A pointer to local variable holding ring-buffer stream position</param>
+/// <returns>TRUE if element was abandoned and read was committed, FALSE if element can be read</returns>
+BOOL ntringb_skip_abandoned(PNTRINGB_POS p_ringb_pos) {
+	NTRINGB_SEQ volatile *p_skip_mark;
+
+	if (NULL == p_ringb_pos->p_local->p_skip_marks)
+	{
+		return FALSE;
+	}
+
+	p_skip_mark = &(p_ringb_pos->p_local->p_skip_marks[p_ringb_pos->current_pos & p_ringb_pos->p_local->skip_mask]);
+
+	if (p_ringb_pos->current_pos != *p_skip_mark)
+	{
+		return FALSE;
+	}
+
+	// Clear mark, so that it cannot match after positions wrap around
+	*p_skip_mark = p_ringb_pos->current_pos - 1;
+
+	ntringb_commit_read(p_ringb_pos);
+	return TRUE;
+}
+
+/// <summary>
+/// Begin writing one element, and wait until deadline
+/// 
+/// Note: waiting thread is counted as parked writer, but it parks only in slices
+/// with NTRINGB_PARK_SLICE, so that it can observe deadline.
+/// </summary>
+/// <param name="p_ringb_pos">A pointer to local variable holding ring-buffer stream position</param>
+/// <param name="deadline">Value of NTRINGB_TIMESTAMP() when to stop waiting</param>
+/// <param name="p_buffer_pos">A pointer to variable receiving index of the available space</param>
+/// <returns>NTRINGB_WAIT_SUCCESS, NTRINGB_WAIT_TIMEOUT, or NTRINGB_WAIT_CLOSED</returns>
+LONG ntringb_timed_begin_write(PNTRINGB_POS p_ringb_pos, LONG64 deadline, PLONG p_buffer_pos) {
+	NTRINGB_WAIT wait;
+
+	ntringb_wait_init(&wait, &(p_ringb_pos->p_ringb->last_read_pos), &(p_ringb_pos->p_ringb->write_waiters));
+	ntringb_wait_closable(&wait, &(p_ringb_pos->p_ringb->closed));
+	ntringb_wait_timed(&wait);
+
+	for (;;)
+	{
+		if (FALSE != ReadAcquire(&(p_ringb_pos->p_ringb->closed)))
+		{
+			return NTRINGB_WAIT_CLOSED;
+		}
+
+		if (ntringb_try_begin_write(p_ringb_pos, p_buffer_pos))
+		{
+			return NTRINGB_WAIT_SUCCESS;
+		}
+
+		if (0 <= NTRINGB_TIMESTAMP() - deadline)
+		{
+			return NTRINGB_WAIT_TIMEOUT;
+		}
+
+		ntringb_wait(&wait);
+		NTRINGB_STATS_COUNT(p_ringb_pos, wait_count);
+	}
+}
+
+/// <summary>
+/// Begin reading one element, and wait until deadline
+/// 
+/// Note: waiting thread is counted as parked reader, but it parks only in slices
+/// with NTRINGB_PARK_SLICE, so that it can observe deadline. Abandoned elements
+/// are passed over.
+/// </summary>
+/// <param name="p_ringb_pos">A pointer to local variable holding ring-buffer stream position</param>
+/// <param name="deadline">Value of NTRINGB_TIMESTAMP() when to stop waiting</param>
+/// <param name="p_buffer_pos">A pointer to variable receiving index of the ready element</param>
+/// <returns>NTRINGB_WAIT_SUCCESS, NTRINGB_WAIT_TIMEOUT, or NTRINGB_WAIT_CLOSED</returns>
+LONG ntringb_timed_begin_read(PNTRINGB_POS p_ringb_pos, LONG64 deadline, PLONG p_buffer_pos) {
+	NTRINGB_WAIT wait;
+
+	ntringb_wait_init(&wait, &(p_ringb_pos->p_ringb->last_write_pos), &(p_ringb_pos->p_ringb->read_waiters));
+	ntringb_wait_closable(&wait, &(p_ringb_pos->p_ringb->closed));
+	ntringb_wait_timed(&wait);
+
+	for (;;)
+	{
+		if (ntringb_try_begin_read(p_ringb_pos, p_buffer_pos))
+		{
+			if (ntringb_skip_abandoned(p_ringb_pos))
+			{
+				continue;
+			}
+
+			return NTRINGB_WAIT_SUCCESS;
+		}
+
+		if (FALSE != ReadAcquire(&(p_ringb_pos->p_ringb->closed)))
+		{
+			return NTRINGB_WAIT_CLOSED;
+		}
+
+		if (0 <= NTRINGB_TIMESTAMP() - deadline)
+		{
+			return NTRINGB_WAIT_TIMEOUT;
+		}
+
+		ntringb_wait(&wait);
+		NTRINGB_STATS_COUNT(p_ringb_pos, wait_count);
+	}
+}
+
+//
+// Snapshot
+//
+// Note: snapshot reads positions of ring-buffer without writing to it, so it
+// can be taken at any time, e.g. from watchdog, or from debugger extension, to
+// tell which position is stuck, and which elements are outstanding. Positions
+// are read from the consumer-side first, and since they only move forward,
+// snapshot always holds last_read_pos <= next_read_pos, last_read_pos <=
+// last_write_pos, and last_write_pos <= next_write_pos, without retry.
+// Elements from last_write_pos + 1 to next_write_pos are reserved by writers,
+// and those from last_read_pos + 1 to next_read_pos are reserved by readers.
+//
+
+/// <summary>
+/// Snapshot of Ring-Buffer state
+/// 
+/// Note: occupancy is count of committed elements not yet released by readers,
+/// ready_count is count of committed elements not yet reserved, and it is negative
+/// when readers wait for elements. Pending counts are counts of elements reserved,
+/// and not yet committed, including writers (readers) waiting in begin function.
+/// </summary>
+typedef struct tagNTRINGB_SNAPSHOT {
+	LONG64 timestamp;
+	NTRINGB_SEQ last_read_pos;
+	NTRINGB_SEQ next_read_pos;
+	NTRINGB_SEQ last_write_pos;
+	NTRINGB_SEQ next_write_pos;
+	LONG pow2_buffer_count;
+	LONG occupancy;
+	LONG ready_count;
+	LONG pending_write_count;
+	LONG pending_read_count;
+	LONG read_waiters;
+	LONG write_waiters;
+	LONG closed;
+} NTRINGB_SNAPSHOT, *PNTRINGB_SNAPSHOT;
+
+/// <summary>
+/// Take Snapshot of Ring-Buffer state
+/// 
+/// Note: this is non-blocking, and it uses only acquire loads. Take two snapshots
+/// some time apart, and positions that didn't move tell which side is stuck.
+/// </summary>
+/// <param name="p_ringb">A pointer to global (or shared) variable holding ring-buffer</param>
+/// <param name="p_result">A pointer to variable receiving snapshot</param>
+void ntringb_snapshot(NTRINGB volatile *p_ringb, PNTRINGB_SNAPSHOT p_result) {
+	p_result->timestamp = NTRINGB_TIMESTAMP();
+	p_result->last_read_pos = NTRINGB_READ_ACQUIRE(&(p_ringb->state.last_read_pos));
+	p_result->next_read_pos = NTRINGB_READ_ACQUIRE(&(p_ringb->state.next_read_pos));
+	p_result->last_write_pos = NTRINGB_READ_ACQUIRE(&(p_ringb->state.last_write_pos));
+	p_result->next_write_pos = NTRINGB_READ_ACQUIRE(&(p_ringb->state.next_write_pos));
+	p_result->pow2_buffer_count = p_ringb->state.pow2_buffer_count;
+	p_result->read_waiters = ReadAcquire(&(p_ringb->state.read_waiters));
+	p_result->write_waiters = ReadAcquire(&(p_ringb->state.write_waiters));
+	p_result->closed = ReadAcquire(&(p_ringb->state.closed));
+
+	p_result->occupancy = (LONG)(p_result->last_write_pos - p_result->last_read_pos);
+	p_result->ready_count = (LONG)(p_result->last_write_pos - p_result->next_read_pos);
+	p_result->pending_write_count = (LONG)(p_result->next_write_pos - p_result->last_write_pos);
+	p_result->pending_read_count = (LONG)(p_result->next_read_pos - p_result->last_read_pos);
+}
+
+//
+// Typed
+//
+// Note: typed ring-buffer bundles ring-buffer control structure together with
+// cache-aligned buffer of user-type elements, and begin functions return pointer
+// to the element in the buffer instead of index, so that you can construct
+// element in place, and read element in place, without copying it.
+//
+// Declare typed ring-buffer of user-type FOO with 1024 elements:
+//
+//		NTRINGB_DECLARE(FOO, 1024);
+//		NTRINGB_FOO g_foo_ringb;
+//
+// Write element in place:
+//
+//		p_foo = NTRINGB_TYPED_BEGIN_WRITE(&g_foo_ringb, &ringb_pos);
+//		p_foo->x = x;
+//		ntringb_commit_write(&ringb_pos);
+//
+// Blocking typed begin macros return NULL where begin function returns NTRINGB_CLOSED_POS,
+// which happens only after ntringb_close(), so check for NULL if ring-buffer can be closed.
+//
+
+// Declare typed ring-buffer data structure NTRINGB_USERTYPE holding pow2_buffer_count elements of USERTYPE
+#define NTRINGB_DECLARE(USERTYPE, pow2_buffer_count) \
+	typedef struct tagNTRINGB_##USERTYPE { \
+		NTRINGB ringb; \
+		DECLSPEC_ALIGN(NTRINGB_CACHE_LINE_SIZE) USERTYPE buffer[pow2_buffer_count]; \
+	} NTRINGB_##USERTYPE, *PNTRINGB_##USERTYPE
+
+// Special macros for construction of typed ring-buffer and its stream positions
+#define NTRINGB_TYPED_INIT(p_typed) ntringb_init(&((p_typed)->ringb), (LONG)(sizeof((p_typed)->buffer) / sizeof((p_typed)->buffer[0])))
+#define NTRINGB_TYPED_POS_INIT(p_typed, p_ringb_pos) ntringb_pos_init(&((p_typed)->ringb), (p_ringb_pos))
+
+// Special macros returning pointer to element at index in typed ring-buffer, e.g. for second part of wrapped batch
+#define NTRINGB_TYPED_PELEMENT(p_typed, buffer_pos) (&((p_typed)->buffer[(buffer_pos) & (p_typed)->ringb.state.pow2_buffer_mask]))
+
+/// <summary>
+/// Tell address of element at index returned by blocking begin function
+/// </summary>
+/// <param name="p_buffer">A pointer to buffer of typed ring-buffer</param>
+/// <param name="element_size">Size of element</param>
+/// <param name="buffer_pos">Index returned by blocking begin function</param>
+/// <returns>A pointer to element, or NULL if begin function returned NTRINGB_CLOSED_POS</returns>
+PVOID ntringb_typed_pelement(PVOID p_buffer, SIZE_T element_size, LONG buffer_pos) {
+	if (NTRINGB_CLOSED_POS == buffer_pos)
+	{
+		return NULL;
+	}
+
+	return (PUCHAR)p_buffer + (SIZE_T)buffer_pos * element_size;
+}
+
+// Special macro converting address of element back to pointer to user-type (C++ doesn't convert PVOID implicitly)
+#ifdef __cplusplus
+#define NTRINGB_TYPED_CAST(p_typed, p_element) static_cast<decltype(&((p_typed)->buffer[0]))>(p_element)
+#else
+#define NTRINGB_TYPED_CAST(p_typed, p_element) (p_element)
+#endif
+
+// Special macro returning pointer to element at index returned by blocking begin function, or NULL on NTRINGB_CLOSED_POS
+#define NTRINGB_TYPED_PBEGIN(p_typed, buffer_pos) \
+	NTRINGB_TYPED_CAST(p_typed, ntringb_typed_pelement((p_typed)->buffer, sizeof((p_typed)->buffer[0]), (buffer_pos)))
+
+// Special macros beginning transactions, and returning pointer to (first) element instead of index
+#define NTRINGB_TYPED_BEGIN_WRITE(p_typed, p_ringb_pos) NTRINGB_TYPED_PBEGIN(p_typed, ntringb_begin_write(p_ringb_pos))
+#define NTRINGB_TYPED_BEGIN_READ(p_typed, p_ringb_pos) NTRINGB_TYPED_PBEGIN(p_typed, ntringb_begin_read(p_ringb_pos))
+#define NTRINGB_TYPED_BEGIN_WRITE_N(p_typed, p_ringb_pos, count, p_contiguous_count) \
+	NTRINGB_TYPED_PBEGIN(p_typed, ntringb_begin_write_n((p_ringb_pos), (count), (p_contiguous_count)))
+#define NTRINGB_TYPED_BEGIN_READ_N(p_typed, p_ringb_pos, count, p_contiguous_count) \
+	NTRINGB_TYPED_PBEGIN(p_typed, ntringb_begin_read_n((p_ringb_pos), (count), (p_contiguous_count)))
+#define NTRINGB_TYPED_POLL_BEGIN_WRITE(p_typed, p_ringb_pos) (&((p_typed)->buffer[ntringb_poll_begin_write(p_ringb_pos)]))
+#define NTRINGB_TYPED_POLL_BEGIN_READ(p_typed, p_ringb_pos) (&((p_typed)->buffer[ntringb_poll_begin_read(p_ringb_pos)]))
+
+//
+// SPSC
+//
+// Note: SPSC ring-buffer can be used only by exactly one producer thread and
+// exactly one consumer thread. It uses no interlocked instructions, only
+// acquire loads and release stores, and each side keeps cached copy of the
+// position of the opposite side, so that it only reads shared position of the
+// other side when cached copy tells that ring-buffer is full (or empty).
+//
+
+/// <summary>
+/// SPSC Ring-Buffer data structure
+/// 
+/// Note: this is control structure, and buffer itself needs to be allocated
+/// separately by the user, same as for NTRINGB.
+/// 
+/// Note: producer-side and consumer-side counters are always on separate cache
+/// line, even without NTRINGB_PADDED, as each side stores its counter on every
+/// commit. With NTRINGB_PADDED defined, buffer count and mask are on read-only
+/// cache line too. If you allocate this structure dynamically, then you must
+/// align it to NTRINGB_CACHE_LINE_SIZE.
+/// </summary>
+typedef struct tagNTRINGB_SPSC {
+	DECLSPEC_ALIGN(NTRINGB_CACHE_LINE_SIZE) NTRINGB_SEQ last_write_pos;
+	LONG read_waiters;
+	DECLSPEC_ALIGN(NTRINGB_CACHE_LINE_SIZE) NTRINGB_SEQ last_read_pos;
+	LONG write_waiters;
+	NTRINGB_CACHE_ALIGN LONG pow2_buffer_count;
+	LONG pow2_buffer_mask;
+
+} NTRINGB_SPSC, *PNTRINGB_SPSC;
+
+/// <summary>
+/// Stream Position in SPSC Ring-Buffer
+/// 
+/// Note: producer thread and consumer thread each need their own local stream
+/// position, since stream position also holds cached position of the other side.
+/// </summary>
+typedef struct tagNTRINGB_SPSC_POS {
+	NTRINGB_SPSC volatile *p_ringb;
+	NTRINGB_SEQ current_pos;
+	NTRINGB_SEQ cached_pos;
+} NTRINGB_SPSC_POS, *PNTRINGB_SPSC_POS;
+
+/// <summary>
+/// Construct SPSC Ring-Buffer
+/// </summary>
+/// <param name="p_ringb">A pointer to global (or shared) variable holding ring-buffer</param>
+/// <param name="pow2_buffer_count">Total count of elements in the ring-buffer. Must be power of 2!</param>
+void ntringb_spsc_init(NTRINGB_SPSC volatile *p_ringb, LONG pow2_buffer_count) {
+	p_ringb->last_write_pos = -1;
+	p_ringb->last_read_pos = -1;
+	p_ringb->read_waiters = 0;
+	p_ringb->write_waiters = 0;
+	p_ringb->pow2_buffer_count = pow2_buffer_count;
+	p_ringb->pow2_buffer_mask = pow2_buffer_count - 1;
+}
+
+/// <summary>
+/// Contruct Stream Position in the SPSC Ring-Buffer
+/// </summary>
+/// <param name="p_ringb">A pointer to global (or shared) variable holding ring-buffer</param>
+/// <param name="p_result">A pointer to local variable holding ring-buffer stream position</param>
+void ntringb_spsc_pos_init(NTRINGB_SPSC volatile *p_ringb, PNTRINGB_SPSC_POS p_result) {
+	p_result->p_ringb = p_ringb;
+	p_result->current_pos = -1;
+	p_result->cached_pos = -1;
+}
+
+/// <summary>
+/// Tell available space for writing, and refresh cached position of the consumer
+/// </summary>
+/// <param name="p_ringb_pos">A pointer to local variable holding ring-buffer stream position</param>
+/// <returns>Count of spaces available</returns>
+LONG ntringb_spsc_available_write(PNTRINGB_SPSC_POS p_ringb_pos) {
+	LONG available = 0;
+
+	p_ringb_pos->cached_pos = NTRINGB_READ_ACQUIRE(&(p_ringb_pos->p_ringb->last_read_pos));
+	available = (LONG)(p_ringb_pos->p_ringb->pow2_buffer_count + p_ringb_pos->cached_pos - p_ringb_pos->current_pos + 1);
+
+	return available;
+}
+
+/// <summary>
+/// Tell available space for reading, and refresh cached position of the producer
+/// </summary>
+/// <param name="p_ringb_pos">A pointer to local variable holding ring-buffer stream position</param>
+/// <returns>Count of spaces available</returns>
+LONG ntringb_spsc_available_read(PNTRINGB_SPSC_POS p_ringb_pos) {
+	LONG available = 0;
+
+	p_ringb_pos->cached_pos = NTRINGB_READ_ACQUIRE(&(p_ringb_pos->p_ringb->last_write_pos));
+	available = (LONG)(p_ringb_pos->cached_pos - p_ringb_pos->current_pos + 1);
+
+	return available;
+}
+
+/// <summary>
+/// Begin writing one element
+/// </summary>
+/// <param name="p_ringb_pos">A pointer to local variable holding ring-buffer stream position</param>
+/// <returns>Index of the available space</returns>
+LONG ntringb_spsc_begin_write(PNTRINGB_SPSC_POS p_ringb_pos) {
+	NTRINGB_WAIT wait;
+	LONG buffer_pos = 0;
+	p_ringb_pos->current_pos = p_ringb_pos->p_ringb->last_write_pos + 1;
+
+	if (p_ringb_pos->p_ringb->pow2_buffer_count + p_ringb_pos->cached_pos - p_ringb_pos->current_pos < 0)
+	{
+		ntringb_wait_init(&wait, &(p_ringb_pos->p_ringb->last_read_pos), &(p_ringb_pos->p_ringb->write_waiters));
+
+		while (ntringb_spsc_available_write(p_ringb_pos) < 1)
+		{
+			ntringb_wait(&wait);
+		}
+	}
+
+	buffer_pos = (LONG)(p_ringb_pos->current_pos & p_ringb_pos->p_ringb->pow2_buffer_mask);
+	return buffer_pos;
+}
+
+/// <summary>
+/// Begin reading one element
+/// </summary>
+/// <param name="p_ringb_pos">A pointer to local variable holding ring-buffer stream position</param>
+/// <returns>Index of the ready element</returns>
+LONG ntringb_spsc_begin_read(PNTRINGB_SPSC_POS p_ringb_pos) {
+	NTRINGB_WAIT wait;
+	LONG buffer_pos = 0;
+	p_ringb_pos->current_pos = p_ringb_pos->p_ringb->last_read_pos + 1;
+
+	if (p_ringb_pos->cached_pos - p_ringb_pos->current_pos < 0)
+	{
+		ntringb_wait_init(&wait, &(p_ringb_pos->p_ringb->last_write_pos), &(p_ringb_pos->p_ringb->read_waiters));
+
+		while (ntringb_spsc_available_read(p_ringb_pos) < 1)
+		{
+			ntringb_wait(&wait);
+		}
+	}
+
+	buffer_pos = (LONG)(p_ringb_pos->current_pos & p_ringb_pos->p_ringb->pow2_buffer_mask);
+	return buffer_pos;
+}
+
+/// <summary>
+/// Commit writing one element
+/// </summary>
+/// <param name="p_ringb_pos">A pointer to local variable holding ring-buffer stream position</param>
+void ntringb_spsc_commit_write(PNTRINGB_SPSC_POS p_ringb_pos) {
+	NTRINGB_WRITE_RELEASE(&(p_ringb_pos->p_ringb->last_write_pos), p_ringb_pos->current_pos);
+	ntringb_wake(&(p_ringb_pos->p_ringb->last_write_pos), &(p_ringb_pos->p_ringb->read_waiters));
+}
+
+/// <summary>
+/// Commit reading one element
+/// </summary>
+/// <param name="p_ringb_pos">A pointer to local variable holding ring-buffer stream position</param>
+void ntringb_spsc_commit_read(PNTRINGB_SPSC_POS p_ringb_pos) {
+	NTRINGB_WRITE_RELEASE(&(p_ringb_pos->p_ringb->last_read_pos), p_ringb_pos->current_pos);
+	ntringb_wake(&(p_ringb_pos->p_ringb->last_read_pos), &(p_ringb_pos->p_ringb->write_waiters));
+}
+
+/// <summary>
+/// Begin writing one element (async)
+/// </summary>
+/// <param name="p_ringb_pos">A pointer to local variable holding ring-buffer stream position</param>
+/// <returns>Index of the space, which may not be ready yet</returns>
+LONG ntringb_spsc_poll_begin_write(PNTRINGB_SPSC_POS p_ringb_pos) {
+	LONG buffer_pos = 0;
+	p_ringb_pos->current_pos = p_ringb_pos->p_ringb->last_write_pos + 1;
+
+	buffer_pos = (LONG)(p_ringb_pos->current_pos & p_ringb_pos->p_ringb->pow2_buffer_mask);
+	return buffer_pos;
+}
+
+/// <summary>
+/// Begin reading one element (async)
+/// </summary>
+/// <param name="p_ringb_pos">A pointer to local variable holding ring-buffer stream position</param>
+/// <returns>Index of the element, which may not be ready yet</returns>
+LONG ntringb_spsc_poll_begin_read(PNTRINGB_SPSC_POS p_ringb_pos) {
+	LONG buffer_pos = 0;
+	p_ringb_pos->current_pos = p_ringb_pos->p_ringb->last_read_pos + 1;
+
+	buffer_pos = (LONG)(p_ringb_pos->current_pos & p_ringb_pos->p_ringb->pow2_buffer_mask);
+	return buffer_pos;
+}
+
+/// <summary>
+/// Tell if space is ready for writing 
+/// </summary>
+/// <param name="p_ringb_pos">A pointer to local variable holding ring-buffer stream position</param>
+/// <returns>TRUE if space can be written to, FALSE if need to wait, and try again later</returns>
+BOOL ntringb_spsc_poll_write_ready(PNTRINGB_SPSC_POS p_ringb_pos) {
+	if (0 <= p_ringb_pos->p_ringb->pow2_buffer_count + p_ringb_pos->cached_pos - p_ringb_pos->current_pos)
+	{
+		return TRUE;
+	}
+
+	return (0 < ntringb_spsc_available_write(p_ringb_pos));
+}
+
+/// <summary>
+/// Tell if element is ready for reading
+/// </summary>
+/// <param name="p_ringb_pos">A pointer to local variable holding ring-buffer stream position</param>
+/// <returns>TRUE if element can be read from, FALSE if need to wait, and try again later</returns>
+BOOL ntringb_spsc_poll_read_ready(PNTRINGB_SPSC_POS p_ringb_pos) {
+	if (0 <= p_ringb_pos->cached_pos - p_ringb_pos->current_pos)
+	{
+		return TRUE;
+	}
+
+	return (0 < ntringb_spsc_available_read(p_ringb_pos));
+}
+
+//
+// Lanes
+//
+// Note: multi-lane ring-buffer groups SPSC lanes under one handle, one lane per
+// producer, so that producers share no counters, and each of them writes only its
+// own cache lines. Single consumer drains lanes round-robin in batches, and commits
+// each batch with single release store. This is MPSC, where producers scale with
+// count of lanes, but there is no ordering between elements of different lanes.
+// 
+// Lane can also be assigned per CPU, provided that producer cannot be preempted
+// between begin and commit, e.g. in Kernel Mode at DISPATCH_LEVEL.
+// 
+// Timestamp merge is optional. If array of timestamps is given, each producer
+// stores NTRINGB_TIMESTAMP() of committed element, and consumer can read element
+// with the oldest timestamp among heads of all lanes, i.e. ordering holds for
+// elements committed before the merge, and later commit can still be older.
+//
+
+// Maximum count of lanes in multi-lane ring-buffer
+#define NTRINGB_LANES_MAX_COUNT 64
+
+// Special macro for index of the first element of the lane in the buffer shared by all lanes
+#define NTRINGB_LANE_BASE(p_lanes, lane_index) ((lane_index) * (p_lanes)->pow2_buffer_count)
+
+/// <summary>
+/// Lane of Multi-Lane Ring-Buffer
+/// 
+/// Note: lane is always aligned to cache line, and counters of producer and of
+/// consumer are on separate cache lines of NTRINGB_SPSC, so that neither producers
+/// of adjacent lanes, nor producer and consumer of one lane share cache line even
+/// without NTRINGB_PADDED.
+/// </summary>
+typedef struct tagNTRINGB_LANE {
+	DECLSPEC_ALIGN(NTRINGB_CACHE_LINE_SIZE) NTRINGB_SPSC ringb;
+
+} NTRINGB_LANE, *PNTRINGB_LANE;
+
+/// <summary>
+/// Multi-Lane Ring-Buffer data structure
+/// 
+/// Note: this is control structure, and both array of lanes and buffer need to be
+/// allocated separately by the user. Buffer holds pow2_buffer_count elements for
+/// each lane, and lane at lane_index starts at NTRINGB_LANE_BASE(). Read positions
+/// and drain state are private to the consumer thread.
+/// </summary>
+typedef struct tagNTRINGB_LANES {
+	NTRINGB_LANE volatile *p_lanes;
+	LONG64 volatile *p_timestamps;
+	LONG lane_count;
+	LONG pow2_buffer_count;
+	LONG last_index;
+	LONG drain_index;
+	NTRINGB_SPSC_POS read_pos[NTRINGB_LANES_MAX_COUNT];
+
+} NTRINGB_LANES, *PNTRINGB_LANES;
+
+/// <summary>
+/// Stream Position of producer in Multi-Lane Ring-Buffer
+/// </summary>
+typedef struct tagNTRINGB_LANES_POS {
+	NTRINGB_SPSC_POS lane_pos;
+	LONG base_pos;
+	LONG64 volatile *p_timestamps;
+} NTRINGB_LANES_POS, *PNTRINGB_LANES_POS;
+
+/// <summary>
+/// Construct Multi-Lane Ring-Buffer
+/// </summary>
+/// <param name="p_lanes">A pointer to global variable holding multi-lane ring-buffer</param>
+/// <param name="p_lane_array">A pointer to array of lane_count lanes</param>
+/// <param name="lane_count">Count of lanes. Must not exceed NTRINGB_LANES_MAX_COUNT!</param>
+/// <param name="pow2_buffer_count">Count of elements in each lane. Must be power of 2!</param>
+/// <param name="p_timestamps">A pointer to array of timestamps, one for each element of the buffer, or NULL not to merge by timestamp</param>
+void ntringb_lanes_init(PNTRINGB_LANES p_lanes, NTRINGB_LANE volatile *p_lane_array, LONG lane_count, LONG pow2_buffer_count, LONG64 volatile *p_timestamps) {
+	LONG i;
+
+	p_lanes->p_lanes = p_lane_array;
+	p_lanes->p_timestamps = p_timestamps;
+	p_lanes->lane_count = lane_count;
+	p_lanes->pow2_buffer_count = pow2_buffer_count;
+	p_lanes->last_index = lane_count - 1;
+	p_lanes->drain_index = 0;
+
+	for (i = 0; i != lane_count; ++i) {
+		ntringb_spsc_init(&(p_lane_array[i].ringb), pow2_buffer_count);
+		ntringb_spsc_pos_init(&(p_lane_array[i].ringb), &(p_lanes->read_pos[i]));
+	}
+}
+
+/// <summary>
+/// Contruct Stream Position of producer in the lane of Multi-Lane Ring-Buffer
+/// 
+/// Note: each lane must have at most one producer at a time.
+/// </summary>
+/// <param name="p_lanes">A pointer to global variable holding multi-lane ring-buffer</param>
+/// <param name="lane_index">Index of the lane owned by the producer</param>
+/// <param name="p_result">A pointer to local variable holding stream position</param>
+void ntringb_lanes_pos_init(PNTRINGB_LANES p_lanes, LONG lane_index, PNTRINGB_LANES_POS p_result) {
+	ntringb_spsc_pos_init(&(p_lanes->p_lanes[lane_index].ringb), &(p_result->lane_pos));
+	p_result->base_pos = NTRINGB_LANE_BASE(p_lanes, lane_index);
+	p_result->p_timestamps = p_lanes->p_timestamps;
+}
+
+/// <summary>
+/// Begin writing one element into the lane of the producer
+/// </summary>
+/// <param name="p_lanes_pos">A pointer to local variable holding stream position</param>
+/// <returns>Index of the available space in the buffer shared by all lanes</returns>
+LONG ntringb_lanes_begin_write(PNTRINGB_LANES_POS p_lanes_pos) {
+	return p_lanes_pos->base_pos + ntringb_spsc_begin_write(&(p_lanes_pos->lane_pos));
+}
+
+/// <summary>
+/// Commit writing one element into the lane of the producer
+/// 
+/// Note: timestamp is stored before element is published, if merge is enabled.
+/// </summary>
+/// <param name="p_lanes_pos">A pointer to local variable holding stream position</param>
+void ntringb_lanes_commit_write(PNTRINGB_LANES_POS p_lanes_pos) {
+	if (NULL != p_lanes_pos->p_timestamps)
+	{
+		p_lanes_pos->p_timestamps[p_lanes_pos->base_pos + (LONG)(p_lanes_pos->lane_pos.current_pos & p_lanes_pos->lane_pos.p_ringb->pow2_buffer_mask)] = NTRINGB_TIMESTAMP();
+	}
+
+	ntringb_spsc_commit_write(&(p_lanes_pos->lane_pos));
+}
+
+/// <summary>
+/// Tell count of elements ready in the lane, and position read position at the first of them
+/// </summary>
+/// <param name="p_lanes">A pointer to global variable holding multi-lane ring-buffer</param>
+/// <param name="lane_index">Index of the lane</param>
+/// <returns>Count of elements ready for reading</returns>
+LONG ntringb_lanes_available_read(PNTRINGB_LANES p_lanes, LONG lane_index) {
+	PNTRINGB_SPSC_POS p_read_pos;
+
+	p_read_pos = &(p_lanes->read_pos[lane_index]);
+	p_read_pos->current_pos = p_read_pos->p_ringb->last_read_pos + 1;
+
+	// Shared position of the producer is read only once cached copy is exhausted
+	if (p_read_pos->cached_pos - p_read_pos->current_pos < 0)
+	{
+		return ntringb_spsc_available_read(p_read_pos);
+	}
+
+	return (LONG)(p_read_pos->cached_pos - p_read_pos->current_pos + 1);
+}
+
+/// <summary>
+/// Begin draining up to max_count elements from the next lane, which has elements
+/// 
+/// Note: search continues round-robin after lane drained last time, so busy
+/// producer cannot starve the others. Elements are contiguous in the lane, and
+/// may wrap around its end, in which case the second part starts at
+/// NTRINGB_LANE_BASE() of the lane, returned in p_lane_index.
+/// </summary>
+/// <param name="p_lanes">A pointer to global variable holding multi-lane ring-buffer</param>
+/// <param name="max_count">Maximum count of elements to read</param>
+/// <param name="p_lane_index">A pointer to variable receiving index of the lane</param>
+/// <param name="p_buffer_pos">A pointer to variable receiving index of the first element in the buffer shared by all lanes</param>
+/// <param name="p_contiguous_count">A pointer to variable receiving count of elements at returned index before lane wraps around</param>
+/// <returns>Count of elements to read, or zero if all lanes are empty</returns>
+LONG ntringb_lanes_begin_drain(PNTRINGB_LANES p_lanes, LONG max_count, PLONG p_lane_index, PLONG p_buffer_pos, PLONG p_contiguous_count) {
+	PNTRINGB_SPSC_POS p_read_pos;
+	LONG index = p_lanes->last_index;
+	LONG count = 0;
+	LONG buffer_pos = 0;
+	LONG contiguous_count = 0;
+	LONG i;
+
+	for (i = 0; i != p_lanes->lane_count; ++i) {
+		index = (index + 1 == p_lanes->lane_count) ? 0 : index + 1;
+		count = ntringb_lanes_available_read(p_lanes, index);
+
+		if (0 < count)
+		{
+			break;
+		}
+	}
+
+	if (count < 1)
+	{
+		return 0;
+	}
+
+	if (max_count < count)
+	{
+		count = max_count;
+	}
+
+	p_read_pos = &(p_lanes->read_pos[index]);
+	buffer_pos = (LONG)(p_read_pos->current_pos & p_read_pos->p_ringb->pow2_buffer_mask);
+	contiguous_count = p_lanes->pow2_buffer_count - buffer_pos;
+
+	// Read position tracks last element, so that commit publishes the whole batch
+	p_read_pos->current_pos += count - 1;
+	p_lanes->last_index = index;
+	p_lanes->drain_index = index;
+
+	*p_lane_index = index;
+	*p_buffer_pos = NTRINGB_LANE_BASE(p_lanes, index) + buffer_pos;
+	*p_contiguous_count = (count < contiguous_count) ? count : contiguous_count;
+	return count;
+}
+
+/// <summary>
+/// Begin reading one element with the oldest timestamp among heads of all lanes
+/// 
+/// Note: this requires array of timestamps to be given to ntringb_lanes_init().
+/// </summary>
+/// <param name="p_lanes">A pointer to global variable holding multi-lane ring-buffer</param>
+/// <param name="p_buffer_pos">A pointer to variable receiving index of the element in the buffer shared by all lanes</param>
+/// <returns>TRUE if element is ready, FALSE if all lanes are empty</returns>
+BOOL ntringb_lanes_begin_merge(PNTRINGB_LANES p_lanes, PLONG p_buffer_pos) {
+	PNTRINGB_SPSC_POS p_read_pos;
+	LONG64 timestamp = 0;
+	LONG64 oldest_timestamp = 0;
+	LONG buffer_pos = 0;
+	LONG oldest_index = -1;
+	LONG i;
+
+	for (i = 0; i != p_lanes->lane_count; ++i) {
+		if (ntringb_lanes_available_read(p_lanes, i) < 1)
+		{
+			continue;
+		}
+
+		p_read_pos = &(p_lanes->read_pos[i]);
+		buffer_pos = NTRINGB_LANE_BASE(p_lanes, i) + (LONG)(p_read_pos->current_pos & p_read_pos->p_ringb->pow2_buffer_mask);
+		timestamp = p_lanes->p_timestamps[buffer_pos];
+
+		if (-1 == oldest_index || timestamp - oldest_timestamp < 0)
+		{
+			oldest_index = i;
+			oldest_timestamp = timestamp;
+			*p_buffer_pos = buffer_pos;
+		}
+	}
+
+	if (-1 == oldest_index)
+	{
+		return FALSE;
+	}
+
+	p_lanes->drain_index = oldest_index;
+	return TRUE;
+}
+
+/// <summary>
+/// Commit draining of elements from the lane
+/// 
+/// Note: this is single release store, same as ntringb_spsc_commit_read().
+/// </summary>
+/// <param name="p_lanes">A pointer to global variable holding multi-lane ring-buffer</param>
+void ntringb_lanes_commit_drain(PNTRINGB_LANES p_lanes) {
+	ntringb_spsc_commit_read(&(p_lanes->read_pos[p_lanes->drain_index]));
+}
+
+//
+// MPMC
+//
+// Note: MPMC ring-buffer keeps sequence number for every element of the buffer,
+// so that each producer and each consumer commits its own element independently
+// of the others. This way producer that gets descheduled between begin and commit
+// only delays consumer of that one element, while other producers can commit, and
+// other consumers can read elements that were already written.
+//
+
+/// <summary>
+/// MPMC Ring-Buffer data structure
+/// 
+/// Note: this is control structure, and both buffer and array of sequence numbers
+/// need to be allocated separately by the user. Array of sequence numbers must have
+/// same count of elements as the buffer.
+/// </summary>
+typedef struct tagNTRINGB_MPMC {
+	NTRINGB_CACHE_ALIGN NTRINGB_SEQ next_write_pos;
+	NTRINGB_CACHE_ALIGN NTRINGB_SEQ next_read_pos;
+	NTRINGB_CACHE_ALIGN LONG pow2_buffer_count;
+	LONG pow2_buffer_mask;
+	NTRINGB_SEQ volatile *p_sequence;
+	NTRINGB_CACHE_ALIGN LONG waiters;
+
+} NTRINGB_MPMC, *PNTRINGB_MPMC;
+
+/// <summary>
+/// Stream Position in MPMC Ring-Buffer
+/// </summary>
+typedef struct tagNTRINGB_MPMC_POS {
+	NTRINGB_MPMC volatile *p_ringb;
+	NTRINGB_SEQ current_pos;
+} NTRINGB_MPMC_POS, *PNTRINGB_MPMC_POS;
+
+/// <summary>
+/// Construct MPMC Ring-Buffer
+/// </summary>
+/// <param name="p_ringb">A pointer to global (or shared) variable holding ring-buffer</param>
+/// <param name="p_sequence">A pointer to array of sequence numbers, one for each element of the buffer</param>
+/// <param name="pow2_buffer_count">Total count of elements in the ring-buffer. Must be power of 2!</param>
+void ntringb_mpmc_init(NTRINGB_MPMC volatile *p_ringb, NTRINGB_SEQ volatile *p_sequence, LONG pow2_buffer_count) {
+	LONG i;
+
+	for (i = 0; i != pow2_buffer_count; ++i) {
+		p_sequence[i] = i;
+	}
+
+	p_ringb->next_write_pos = -1;
+	p_ringb->next_read_pos = -1;
+	p_ringb->pow2_buffer_count = pow2_buffer_count;
+	p_ringb->pow2_buffer_mask = pow2_buffer_count - 1;
+	p_ringb->p_sequence = p_sequence;
+	p_ringb->waiters = 0;
+}
+
+/// <summary>
+/// Contruct Stream Position in the MPMC Ring-Buffer
+/// </summary>
+/// <param name="p_ringb">A pointer to global (or shared) variable holding ring-buffer</param>
+/// <param name="p_result">A pointer to local variable holding ring-buffer stream position</param>
+void ntringb_mpmc_pos_init(NTRINGB_MPMC volatile *p_ringb, PNTRINGB_MPMC_POS p_result) {
+	p_result->p_ringb = p_ringb;
+	p_result->current_pos = -1;
+}
+
+/// <summary>
+/// Begin writing one element (async)
+/// </summary>
+/// <param name="p_ringb_pos">A pointer to local variable holding ring-buffer stream position</param>
+/// <returns>Index of the space, which may not be ready yet</returns>
+LONG ntringb_mpmc_poll_begin_write(PNTRINGB_MPMC_POS p_ringb_pos) {
+	LONG buffer_pos = 0;
+	p_ringb_pos->current_pos = NTRINGB_INTERLOCKED_INCREMENT(&(p_ringb_pos->p_ringb->next_write_pos));
+
+	buffer_pos = (LONG)(p_ringb_pos->current_pos & p_ringb_pos->p_ringb->pow2_buffer_mask);
+	return buffer_pos;
+}
+
+/// <summary>
+/// Begin reading one element (async)
+/// </summary>
+/// <param name="p_ringb_pos">A pointer to local variable holding ring-buffer stream position</param>
+/// <returns>Index of the element, which may not be ready yet</returns>
+LONG ntringb_mpmc_poll_begin_read(PNTRINGB_MPMC_POS p_ringb_pos) {
+	LONG buffer_pos = 0;
+	p_ringb_pos->current_pos = NTRINGB_INTERLOCKED_INCREMENT(&(p_ringb_pos->p_ringb->next_read_pos));
+
+	buffer_pos = (LONG)(p_ringb_pos->current_pos & p_ringb_pos->p_ringb->pow2_buffer_mask);
+	return buffer_pos;
+}
+
+/// <summary>
+/// Tell if space is ready for writing, i.e. previous element at that space was read
+/// </summary>
+/// <param name="p_ringb_pos">A pointer to local variable holding ring-buffer stream position</param>
+/// <returns>TRUE if space can be written to, FALSE if need to wait, and try again later</returns>
+BOOL ntringb_mpmc_poll_write_ready(PNTRINGB_MPMC_POS p_ringb_pos) {
+	NTRINGB_SEQ sequence;
+
+	sequence = NTRINGB_READ_ACQUIRE(&(p_ringb_pos->p_ringb->p_sequence[p_ringb_pos->current_pos & p_ringb_pos->p_ringb->pow2_buffer_mask]));
+
+	return (0 <= sequence - p_ringb_pos->current_pos);
+}
+
+/// <summary>
+/// Tell if element is ready for reading, i.e. its producer has committed it
+/// </summary>
+/// <param name="p_ringb_pos">A pointer to local variable holding ring-buffer stream position</param>
+/// <returns>TRUE if element can be read from, FALSE if need to wait, and try again later</returns>
+BOOL ntringb_mpmc_poll_read_ready(PNTRINGB_MPMC_POS p_ringb_pos) {
+	NTRINGB_SEQ sequence;
+
+	sequence = NTRINGB_READ_ACQUIRE(&(p_ringb_pos->p_ringb->p_sequence[p_ringb_pos->current_pos & p_ringb_pos->p_ringb->pow2_buffer_mask]));
+
+	return (0 <= sequence - p_ringb_pos->current_pos - 1);
+}
+
+/// <summary>
+/// Try begin writing one element, without reserving space unless it is available
+/// </summary>
+/// <param name="p_ringb_pos">A pointer to local variable holding ring-buffer stream position</param>
+/// <param name="p_buffer_pos">A pointer to variable receiving index of the available space</param>
+/// <returns>TRUE if space was reserved, FALSE if ring-buffer is full, and try again later</returns>
+BOOL ntringb_mpmc_try_begin_write(PNTRINGB_MPMC_POS p_ringb_pos, PLONG p_buffer_pos) {
+	NTRINGB_SEQ next_write_pos;
+
+	do {
+		next_write_pos = p_ringb_pos->p_ringb->next_write_pos;
+		p_ringb_pos->current_pos = next_write_pos + 1;
+
+		if (FALSE == ntringb_mpmc_poll_write_ready(p_ringb_pos))
+		{
+			return FALSE;
+		}
+
+	} while (next_write_pos != NTRINGB_INTERLOCKED_COMPARE_EXCHANGE(
+		&(p_ringb_pos->p_ringb->next_write_pos),
+		next_write_pos + 1,
+		next_write_pos));
+
+	*p_buffer_pos = (LONG)(p_ringb_pos->current_pos & p_ringb_pos->p_ringb->pow2_buffer_mask);
+	return TRUE;
+}
+
+/// <summary>
+/// Try begin reading one element, without reserving element unless it is ready
+/// </summary>
+/// <param name="p_ringb_pos">A pointer to local variable holding ring-buffer stream position</param>
+/// <param name="p_buffer_pos">A pointer to variable receiving index of the ready element</param>
+/// <returns>TRUE if element was reserved, FALSE if ring-buffer is empty, and try again later</returns>
+BOOL ntringb_mpmc_try_begin_read(PNTRINGB_MPMC_POS p_ringb_pos, PLONG p_buffer_pos) {
+	NTRINGB_SEQ next_read_pos;
+
+	do {
+		next_read_pos = p_ringb_pos->p_ringb->next_read_pos;
+		p_ringb_pos->current_pos = next_read_pos + 1;
+
+		if (FALSE == ntringb_mpmc_poll_read_ready(p_ringb_pos))
+		{
+			return FALSE;
+		}
+
+	} while (next_read_pos != NTRINGB_INTERLOCKED_COMPARE_EXCHANGE(
+		&(p_ringb_pos->p_ringb->next_read_pos),
+		next_read_pos + 1,
+		next_read_pos));
+
+	*p_buffer_pos = (LONG)(p_ringb_pos->current_pos & p_ringb_pos->p_ringb->pow2_buffer_mask);
+	return TRUE;
+}
+
+/// <summary>
+/// Begin writing one element
+/// </summary>
+/// <param name="p_ringb_pos">A pointer to local variable holding ring-buffer stream position</param>
+/// <returns>Index of the available space</returns>
+LONG ntringb_mpmc_begin_write(PNTRINGB_MPMC_POS p_ringb_pos) {
+	NTRINGB_WAIT wait;
+	LONG buffer_pos = 0;
+	buffer_pos = ntringb_mpmc_poll_begin_write(p_ringb_pos);
+
+	ntringb_wait_init(&wait, &(p_ringb_pos->p_ringb->p_sequence[buffer_pos]), &(p_ringb_pos->p_ringb->waiters));
+
+	while (FALSE == ntringb_mpmc_poll_write_ready(p_ringb_pos))
+	{
+		ntringb_wait(&wait);
+	}
+
+	return buffer_pos;
+}
+
+/// <summary>
+/// Begin reading one element
+/// </summary>
+/// <param name="p_ringb_pos">A pointer to local variable holding ring-buffer stream position</param>
+/// <returns>Index of the ready element</returns>
+LONG ntringb_mpmc_begin_read(PNTRINGB_MPMC_POS p_ringb_pos) {
+	NTRINGB_WAIT wait;
+	LONG buffer_pos = 0;
+	buffer_pos = ntringb_mpmc_poll_begin_read(p_ringb_pos);
+
+	ntringb_wait_init(&wait, &(p_ringb_pos->p_ringb->p_sequence[buffer_pos]), &(p_ringb_pos->p_ringb->waiters));
+
+	while (FALSE == ntringb_mpmc_poll_read_ready(p_ringb_pos))
+	{
+		ntringb_wait(&wait);
+	}
+
+	return buffer_pos;
+}
+
+/// <summary>
+/// Commit writing one element
+/// 
+/// Note: this never waits for other producers.
+/// </summary>
+/// <param name="p_ringb_pos">A pointer to local variable holding ring-buffer stream position</param>
+void ntringb_mpmc_commit_write(PNTRINGB_MPMC_POS p_ringb_pos) {
+	NTRINGB_WRITE_RELEASE(
+		&(p_ringb_pos->p_ringb->p_sequence[p_ringb_pos->current_pos & p_ringb_pos->p_ringb->pow2_buffer_mask]),
+		p_ringb_pos->current_pos + 1);
+
+	ntringb_wake(
+		&(p_ringb_pos->p_ringb->p_sequence[p_ringb_pos->current_pos & p_ringb_pos->p_ringb->pow2_buffer_mask]),
+		&(p_ringb_pos->p_ringb->waiters));
+}
+
+/// <summary>
+/// Commit reading one element
+/// 
+/// Note: this never waits for other consumers.
+/// </summary>
+/// <param name="p_ringb_pos">A pointer to local variable holding ring-buffer stream position</param>
+void ntringb_mpmc_commit_read(PNTRINGB_MPMC_POS p_ringb_pos) {
+	NTRINGB_WRITE_RELEASE(
+		&(p_ringb_pos->p_ringb->p_sequence[p_ringb_pos->current_pos & p_ringb_pos->p_ringb->pow2_buffer_mask]),
+		p_ringb_pos->current_pos + p_ringb_pos->p_ringb->pow2_buffer_count);
+
+	ntringb_wake(
+		&(p_ringb_pos->p_ringb->p_sequence[p_ringb_pos->current_pos & p_ringb_pos->p_ringb->pow2_buffer_mask]),
+		&(p_ringb_pos->p_ringb->waiters));
+}
+
+//
+// Broadcast
+//
+// Note: broadcast ring-buffer delivers each element to every registered reader,
+// i.e. this is pub-sub. Each reader has its own cursor, and reads elements
+// in place, without copying them. Writers can write only when all readers have
+// finished reading element that was previously stored at that space, and each
+// writer keeps cached position of the slowest reader, so that it only scans
+// cursors of all readers when cached position tells that ring-buffer is full.
+//
+
+/// <summary>
+/// Reader Cursor in Broadcast Ring-Buffer
+/// </summary>
+typedef struct tagNTRINGB_BCAST_CURSOR {
+	NTRINGB_CACHE_ALIGN NTRINGB_SEQ last_read_pos;
+
+} NTRINGB_BCAST_CURSOR, *PNTRINGB_BCAST_CURSOR;
+
+/// <summary>
+/// Broadcast Ring-Buffer data structure
+/// 
+/// Note: this is control structure, and both buffer and array of reader cursors
+/// need to be allocated separately by the user. Array of reader cursors must have
+/// one cursor for each reader.
+/// </summary>
+typedef struct tagNTRINGB_BCAST {
+	NTRINGB_CACHE_ALIGN NTRINGB_SEQ next_write_pos;
+	NTRINGB_CACHE_ALIGN NTRINGB_SEQ last_write_pos;
+	LONG read_waiters;
+	LONG write_waiters;
+	NTRINGB_CACHE_ALIGN LONG pow2_buffer_count;
+	LONG pow2_buffer_mask;
+	LONG reader_count;
+	NTRINGB_BCAST_CURSOR volatile *p_cursors;
+
+} NTRINGB_BCAST, *PNTRINGB_BCAST;
+
+/// <summary>
+/// Stream Position in Broadcast Ring-Buffer
+/// 
+/// Note: each reader and each writer needs its own local stream position. For
+/// reader p_cursor points to its own cursor, and for writer it points to cursor
+/// of the slowest reader as last seen by that writer.
+/// </summary>
+typedef struct tagNTRINGB_BCAST_POS {
+	NTRINGB_BCAST volatile *p_ringb;
+	NTRINGB_BCAST_CURSOR volatile *p_cursor;
+	NTRINGB_SEQ current_pos;
+	NTRINGB_SEQ cached_pos;
+} NTRINGB_BCAST_POS, *PNTRINGB_BCAST_POS;
+
+/// <summary>
+/// Construct Broadcast Ring-Buffer
+/// </summary>
+/// <param name="p_ringb">A pointer to global (or shared) variable holding ring-buffer</param>
+/// <param name="p_cursors">A pointer to array of reader cursors, one for each reader</param>
+/// <param name="reader_count">Total count of readers. Must be at least one!</param>
+/// <param name="pow2_buffer_count">Total count of elements in the ring-buffer. Must be power of 2!</param>
+void ntringb_bcast_init(NTRINGB_BCAST volatile *p_ringb, NTRINGB_BCAST_CURSOR volatile *p_cursors,
+	LONG reader_count, LONG pow2_buffer_count) {
+	LONG i;
+
+	for (i = 0; i != reader_count; ++i) {
+		p_cursors[i].last_read_pos = -1;
+	}
+
+	p_ringb->next_write_pos = -1;
+	p_ringb->last_write_pos = -1;
+	p_ringb->read_waiters = 0;
+	p_ringb->write_waiters = 0;
+	p_ringb->pow2_buffer_count = pow2_buffer_count;
+	p_ringb->pow2_buffer_mask = pow2_buffer_count - 1;
+	p_ringb->reader_count = reader_count;
+	p_ringb->p_cursors = p_cursors;
+}
+
+/// <summary>
+/// Contruct Writer Stream Position in the Broadcast Ring-Buffer
+/// </summary>
+/// <param name="p_ringb">A pointer to global (or shared) variable holding ring-buffer</param>
+/// <param name="p_result">A pointer to local variable holding ring-buffer stream position</param>
+void ntringb_bcast_writer_init(NTRINGB_BCAST volatile *p_ringb, PNTRINGB_BCAST_POS p_result) {
+	p_result->p_ringb = p_ringb;
+	p_result->p_cursor = &(p_ringb->p_cursors[0]);
+	p_result->current_pos = -1;
+	p_result->cached_pos = -1;
+}
+
+/// <summary>
+/// Contruct Reader Stream Position in the Broadcast Ring-Buffer
+/// </summary>
+/// <param name="p_ringb">A pointer to global (or shared) variable holding ring-buffer</param>
+/// <param name="reader_index">Index of the reader cursor, which must not be used by any other reader</param>
+/// <param name="p_result">A pointer to local variable holding ring-buffer stream position</param>
+void ntringb_bcast_reader_init(NTRINGB_BCAST volatile *p_ringb, LONG reader_index, PNTRINGB_BCAST_POS p_result) {
+	p_result->p_ringb = p_ringb;
+	p_result->p_cursor = &(p_ringb->p_cursors[reader_index]);
+	p_result->current_pos = -1;
+	p_result->cached_pos = -1;
+}
+
+/// <summary>
+/// Tell available space for writing, and refresh cached position of the slowest reader
+/// </summary>
+/// <param name="p_ringb_pos">A pointer to local variable holding writer stream position</param>
+/// <returns>Count of spaces available</returns>
+LONG ntringb_bcast_available_write(PNTRINGB_BCAST_POS p_ringb_pos) {
+	LONG available = 0;
+	LONG i;
+	NTRINGB_SEQ read_pos;
+	NTRINGB_BCAST_CURSOR volatile *p_cursor;
+
+	p_cursor = &(p_ringb_pos->p_ringb->p_cursors[0]);
+	p_ringb_pos->p_cursor = p_cursor;
+	p_ringb_pos->cached_pos = NTRINGB_READ_ACQUIRE(&(p_cursor->last_read_pos));
+
+	for (i = 1; i < p_ringb_pos->p_ringb->reader_count; ++i)
+	{
+		p_cursor = &(p_ringb_pos->p_ringb->p_cursors[i]);
+		read_pos = NTRINGB_READ_ACQUIRE(&(p_cursor->last_read_pos));
+
+		if (read_pos - p_ringb_pos->cached_pos < 0)
+		{
+			p_ringb_pos->p_cursor = p_cursor;
+			p_ringb_pos->cached_pos = read_pos;
+		}
+	}
+
+	available = (LONG)(p_ringb_pos->p_ringb->pow2_buffer_count + p_ringb_pos->cached_pos - p_ringb_pos->current_pos + 1);
+
+	return available;
+}
+
+/// <summary>
+/// Tell available space for reading, and refresh cached position of the writers
+/// </summary>
+/// <param name="p_ringb_pos">A pointer to local variable holding reader stream position</param>
+/// <returns>Count of spaces available</returns>
+LONG ntringb_bcast_available_read(PNTRINGB_BCAST_POS p_ringb_pos) {
+	LONG available = 0;
+
+	p_ringb_pos->cached_pos = NTRINGB_READ_ACQUIRE(&(p_ringb_pos->p_ringb->last_write_pos));
+	available = (LONG)(p_ringb_pos->cached_pos - p_ringb_pos->current_pos + 1);
+
+	return available;
+}
+
+/// <summary>
+/// Begin writing one element
+/// </summary>
+/// <param name="p_ringb_pos">A pointer to local variable holding writer stream position</param>
+/// <returns>Index of the available space</returns>
+LONG ntringb_bcast_begin_write(PNTRINGB_BCAST_POS p_ringb_pos) {
+	NTRINGB_WAIT wait;
+	LONG buffer_pos = 0;
+	p_ringb_pos->current_pos = NTRINGB_INTERLOCKED_INCREMENT(&(p_ringb_pos->p_ringb->next_write_pos));
+
+	if (p_ringb_pos->p_ringb->pow2_buffer_count + p_ringb_pos->cached_pos - p_ringb_pos->current_pos < 0)
+	{
+		ntringb_wait_init(&wait, &(p_ringb_pos->p_cursor->last_read_pos), &(p_ringb_pos->p_ringb->write_waiters));
+
+		while (ntringb_bcast_available_write(p_ringb_pos) < 1)
+		{
+			ntringb_wait_retarget(&wait, &(p_ringb_pos->p_cursor->last_read_pos), p_ringb_pos->cached_pos);
+			ntringb_wait(&wait);
+		}
+	}
+
+	buffer_pos = (LONG)(p_ringb_pos->current_pos & p_ringb_pos->p_ringb->pow2_buffer_mask);
+	return buffer_pos;
+}
+
+/// <summary>
+/// Begin reading one element
+/// </summary>
+/// <param name="p_ringb_pos">A pointer to local variable holding reader stream position</param>
+/// <returns>Index of the ready element</returns>
+LONG ntringb_bcast_begin_read(PNTRINGB_BCAST_POS p_ringb_pos) {
+	NTRINGB_WAIT wait;
+	LONG buffer_pos = 0;
+	p_ringb_pos->current_pos = p_ringb_pos->p_cursor->last_read_pos + 1;
+
+	if (p_ringb_pos->cached_pos - p_ringb_pos->current_pos < 0)
+	{
+		ntringb_wait_init(&wait, &(p_ringb_pos->p_ringb->last_write_pos), &(p_ringb_pos->p_ringb->read_waiters));
+
+		while (ntringb_bcast_available_read(p_ringb_pos) < 1)
+		{
+			ntringb_wait(&wait);
+		}
+	}
+
+	buffer_pos = (LONG)(p_ringb_pos->current_pos & p_ringb_pos->p_ringb->pow2_buffer_mask);
+	return buffer_pos;
+}
+
+/// <summary>
+/// Commit writing one element
+/// </summary>
+/// <param name="p_ringb_pos">A pointer to local variable holding writer stream position</param>
+void ntringb_bcast_commit_write(PNTRINGB_BCAST_POS p_ringb_pos) {
+	NTRINGB_SEQ last_write_pos;
+
+	last_write_pos = p_ringb_pos->current_pos - 1;
+
+	while (last_write_pos != NTRINGB_INTERLOCKED_COMPARE_EXCHANGE(
+		&(p_ringb_pos->p_ringb->last_write_pos),
+		last_write_pos + 1,
+		last_write_pos))
+	{}
+
+	ntringb_wake(&(p_ringb_pos->p_ringb->last_write_pos), &(p_ringb_pos->p_ringb->read_waiters));
+}
+
+/// <summary>
+/// Commit reading one element
+/// </summary>
+/// <param name="p_ringb_pos">A pointer to local variable holding reader stream position</param>
+void ntringb_bcast_commit_read(PNTRINGB_BCAST_POS p_ringb_pos) {
+	NTRINGB_WRITE_RELEASE(&(p_ringb_pos->p_cursor->last_read_pos), p_ringb_pos->current_pos);
+	ntringb_wake(&(p_ringb_pos->p_cursor->last_read_pos), &(p_ringb_pos->p_ringb->write_waiters));
+}
+
+/// <summary>
+/// Begin reading one element (async)
+/// </summary>
+/// <param name="p_ringb_pos">A pointer to local variable holding reader stream position</param>
+/// <returns>Index of the element, which may not be ready yet</returns>
+LONG ntringb_bcast_poll_begin_read(PNTRINGB_BCAST_POS p_ringb_pos) {
+	LONG buffer_pos = 0;
+	p_ringb_pos->current_pos = p_ringb_pos->p_cursor->last_read_pos + 1;
+
+	buffer_pos = (LONG)(p_ringb_pos->current_pos & p_ringb_pos->p_ringb->pow2_buffer_mask);
+	return buffer_pos;
+}
+
+/// <summary>
+/// Tell if element is ready for reading
+/// </summary>
+/// <param name="p_ringb_pos">A pointer to local variable holding reader stream position</param>
+/// <returns>TRUE if element can be read from, FALSE if need to wait, and try again later</returns>
+BOOL ntringb_bcast_poll_read_ready(PNTRINGB_BCAST_POS p_ringb_pos) {
+	if (0 <= p_ringb_pos->cached_pos - p_ringb_pos->current_pos)
+	{
+		return TRUE;
+	}
+
+	return (0 < ntringb_bcast_available_read(p_ringb_pos));
+}
+
+//
+// Message
+//
+// Note: message ring-buffer is a byte buffer holding variable-length records,
+// each prefixed with a header holding its length. It uses same positions and
+// same begin/commit protocol as NTRINGB, only positions count bytes instead of
+// elements. If record does not fit before the end of the buffer, then producer
+// writes padding record up to the end of the buffer, and writes the record at
+// the start of the buffer, so that each record is contiguous in memory.
+// Padding and record are reserved, committed and consumed as single entry.
+// 
+// Once ring-buffer is closed, begin functions that would wait return NULL, and
+// writer releases space it has reserved, so that commits are stopped at it.
+// Readers of records don't pass over abandoned space, so that skip must not be
+// enabled on message ring-buffer.
+//
+
+// Alignment of records in message ring-buffer. Buffer must be aligned at least to this.
+#define NTRINGB_MSG_ALIGNMENT 8
+
+// Length of padding record, which spans to the end of the buffer
+#define NTRINGB_MSG_PADDING (-1)
+
+/// <summary>
+/// Record Header in Message Ring-Buffer
+/// </summary>
+typedef struct tagNTRINGB_MSG_HEADER {
+	LONG length;
+	LONG reserved;
+
+} NTRINGB_MSG_HEADER, *PNTRINGB_MSG_HEADER;
+
+// Special macros for size of record, and for extraction of header and payload
+#define NTRINGB_MSG_RECORD_SIZE(length) \
+	(((LONG)sizeof(NTRINGB_MSG_HEADER) + (length) + NTRINGB_MSG_ALIGNMENT - 1) & ~(NTRINGB_MSG_ALIGNMENT - 1))
+#define NTRINGB_MSG_PHEADER(p_buffer, buffer_pos) ((NTRINGB_MSG_HEADER volatile *)((PUCHAR)(p_buffer) + (buffer_pos)))
+#define NTRINGB_MSG_PPAYLOAD(p_buffer, buffer_pos) ((PVOID)((PUCHAR)(p_buffer) + (buffer_pos) + sizeof(NTRINGB_MSG_HEADER)))
+
+/// <summary>
+/// Message Ring-Buffer data structure
+/// 
+/// Note: this is control structure, and byte buffer needs to be allocated
+/// separately by the user.
+/// </summary>
+typedef struct tagNTRINGB_MSG {
+	NTRINGB ringb;
+	PUCHAR p_buffer;
+
+} NTRINGB_MSG, *PNTRINGB_MSG;
+
+/// <summary>
+/// Stream Position in Message Ring-Buffer
+/// 
+/// Note: current_pos is position of the last byte of current entry, and
+/// current_count is size of current entry in bytes, including padding.
+/// </summary>
+typedef struct tagNTRINGB_MSG_POS {
+	NTRINGB_POS ringb_pos;
+	PUCHAR p_buffer;
+} NTRINGB_MSG_POS, *PNTRINGB_MSG_POS;
+
+/// <summary>
+/// Construct Message Ring-Buffer
+/// </summary>
+/// <param name="p_ringb">A pointer to global (or shared) variable holding ring-buffer</param>
+/// <param name="p_buffer">A pointer to byte buffer aligned at least to NTRINGB_MSG_ALIGNMENT</param>
+/// <param name="pow2_buffer_size">Total size of the buffer in bytes. Must be power of 2!</param>
+void ntringb_msg_init(NTRINGB_MSG volatile *p_ringb, PVOID p_buffer, LONG pow2_buffer_size) {
+	ntringb_init(&(p_ringb->ringb), pow2_buffer_size);
+	p_ringb->p_buffer = (PUCHAR)p_buffer;
+}
+
+/// <summary>
+/// Contruct Stream Position in the Message Ring-Buffer
+/// </summary>
+/// <param name="p_ringb">A pointer to global (or shared) variable holding ring-buffer</param>
+/// <param name="p_result">A pointer to local variable holding ring-buffer stream position</param>
+void ntringb_msg_pos_init(NTRINGB_MSG volatile *p_ringb, PNTRINGB_MSG_POS p_result) {
+	ntringb_pos_init(&(p_ringb->ringb), &(p_result->ringb_pos));
+	p_result->p_buffer = p_ringb->p_buffer;
+}
+
+/// <summary>
+/// Begin writing one record
+/// 
+/// Note: record and padding before it must fit into the buffer, which is always
+/// so if length is less than half of the buffer size. Otherwise nothing is
+/// reserved, and NULL is returned, as space would never become available.
+/// </summary>
+/// <param name="p_ringb_pos">A pointer to local variable holding ring-buffer stream position</param>
+/// <param name="length">Length of the record in bytes. Must be less than half of the buffer size!</param>
+/// <returns>A pointer to contiguous space for the record, or NULL if record does not fit, or if ring-buffer was closed while waiting</returns>
+PVOID ntringb_msg_begin_write(PNTRINGB_MSG_POS p_ringb_pos, LONG length) {
+	NTRINGB_WAIT wait;
+	NTRINGB_STATE volatile *p_ringb;
+	NTRINGB_SEQ last_write_pos;
+	LONG buffer_pos = 0;
+	LONG record_size = 0;
+	LONG padding_size = 0;
+
+	p_ringb = p_ringb_pos->ringb_pos.p_ringb;
+	record_size = NTRINGB_MSG_RECORD_SIZE(length);
+
+	// Reserve space for the record, and also padding if record would not fit before the end
+	do {
+		last_write_pos = p_ringb->next_write_pos;
+		buffer_pos = (LONG)((last_write_pos + 1) & p_ringb_pos->ringb_pos.pow2_buffer_mask);
+		padding_size = (p_ringb_pos->ringb_pos.pow2_buffer_count - buffer_pos < record_size) ? (p_ringb_pos->ringb_pos.pow2_buffer_count - buffer_pos) : 0;
+
+		if (p_ringb_pos->ringb_pos.pow2_buffer_count < padding_size + record_size)
+		{
+			return NULL;
+		}
+
+	} while (last_write_pos != NTRINGB_INTERLOCKED_COMPARE_EXCHANGE(
+		&(p_ringb->next_write_pos),
+		last_write_pos + padding_size + record_size,
+		last_write_pos));
+
+	p_ringb_pos->ringb_pos.current_pos = last_write_pos + padding_size + record_size;
+	p_ringb_pos->ringb_pos.current_count = padding_size + record_size;
+
+	ntringb_wait_init(&wait, &(p_ringb->last_read_pos), &(p_ringb->write_waiters));
+	ntringb_wait_closable(&wait, &(p_ringb->closed));
+
+	while (ntringb_available_write(&(p_ringb_pos->ringb_pos)) < 1)
+	{
+		if (FALSE != ReadAcquire(&(p_ringb->closed)))
+		{
+			ntringb_release_write(&(p_ringb_pos->ringb_pos), p_ringb_pos->ringb_pos.current_count);
+			return NULL;
+		}
+
+		ntringb_wait(&wait);
+	}
+
+	if (0 != padding_size)
+	{
+		NTRINGB_MSG_PHEADER(p_ringb_pos->p_buffer, buffer_pos)->length = NTRINGB_MSG_PADDING;
+		buffer_pos = 0;
+	}
+
+	NTRINGB_MSG_PHEADER(p_ringb_pos->p_buffer, buffer_pos)->length = length;
+	return NTRINGB_MSG_PPAYLOAD(p_ringb_pos->p_buffer, buffer_pos);
+}
+
+/// <summary>
+/// Begin reading one record
+/// </summary>
+/// <param name="p_ringb_pos">A pointer to local variable holding ring-buffer stream position</param>
+/// <param name="p_length">A pointer to variable receiving length of the record in bytes</param>
+/// <returns>A pointer to contiguous record, or NULL if ring-buffer was closed, and all records were read</returns>
+PVOID ntringb_msg_begin_read(PNTRINGB_MSG_POS p_ringb_pos, PLONG p_length) {
+	NTRINGB_WAIT wait;
+	NTRINGB_STATE volatile *p_ringb;
+	NTRINGB_SEQ last_read_pos;
+	LONG buffer_pos = 0;
+	LONG padding_size = 0;
+	LONG length = 0;
+
+	p_ringb = p_ringb_pos->ringb_pos.p_ringb;
+
+	ntringb_wait_init(&wait, &(p_ringb->last_write_pos), &(p_ringb->read_waiters));
+	ntringb_wait_closable(&wait, &(p_ringb->closed));
+
+	// Claim next entry only once it is committed, since its size is in its header
+	for (;;)
+	{
+		last_read_pos = p_ringb->next_read_pos;
+		p_ringb_pos->ringb_pos.current_pos = last_read_pos + 1;
+
+		if (ntringb_available_read(&(p_ringb_pos->ringb_pos)) < 1)
+		{
+			// Nothing is claimed yet, so that there is nothing to release
+			if (FALSE != ReadAcquire(&(p_ringb->closed)) && ntringb_available_read(&(p_ringb_pos->ringb_pos)) < 1)
+			{
+				return NULL;
+			}
+
+			ntringb_wait(&wait);
+			continue;
+		}
+
+		buffer_pos = (LONG)((last_read_pos + 1) & p_ringb_pos->ringb_pos.pow2_buffer_mask);
+		length = NTRINGB_MSG_PHEADER(p_ringb_pos->p_buffer, buffer_pos)->length;
+		padding_size = 0;
+
+		if (NTRINGB_MSG_PADDING == length)
+		{
+			padding_size = p_ringb_pos->ringb_pos.pow2_buffer_count - buffer_pos;
+			buffer_pos = 0;
+			length = NTRINGB_MSG_PHEADER(p_ringb_pos->p_buffer, buffer_pos)->length;
+		}
+
+		p_ringb_pos->ringb_pos.current_count = padding_size + NTRINGB_MSG_RECORD_SIZE(length);
+		p_ringb_pos->ringb_pos.current_pos = last_read_pos + p_ringb_pos->ringb_pos.current_count;
+
+		if (last_read_pos == NTRINGB_INTERLOCKED_COMPARE_EXCHANGE(
+			&(p_ringb->next_read_pos),
+			p_ringb_pos->ringb_pos.current_pos,
+			last_read_pos))
+		{
+			break;
+		}
+	}
+
+	*p_length = length;
+	return NTRINGB_MSG_PPAYLOAD(p_ringb_pos->p_buffer, buffer_pos);
+}
+
+/// <summary>
+/// Commit writing one record
+/// </summary>
+/// <param name="p_ringb_pos">A pointer to local variable holding ring-buffer stream position</param>
+void ntringb_msg_commit_write(PNTRINGB_MSG_POS p_ringb_pos) {
+	ntringb_commit_write_n(&(p_ringb_pos->ringb_pos));
+}
+
+/// <summary>
+/// Commit reading one record
+/// </summary>
+/// <param name="p_ringb_pos">A pointer to local variable holding ring-buffer stream position</param>
+void ntringb_msg_commit_read(PNTRINGB_MSG_POS p_ringb_pos) {
+	ntringb_commit_read_n(&(p_ringb_pos->ringb_pos));
+}
+
+//
+// Set
+//
+// Note: readiness set lets single consumer thread service many ring-buffers
+// without scanning idle ones. Producers set bit of the ring-buffer in shared
+// readiness mask on commit, and consumer finds next ready ring-buffer with
+// bit-scan. The bit is cleared only once consumer finds ring-buffer empty.
+// 
+// Ring-buffers must be added to the set before producers start, and each
+// ring-buffer can belong to at most one set.
+// 
+// On x86 readiness mask is still 64-bit, so that interlocked operations on it
+// are compare-exchange loops, and it is scanned with two 32-bit bit-scans.
+//
+
+// Maximum count of ring-buffers in readiness set
+#define NTRINGB_SET_MAX_COUNT 64
+
+/// <summary>
+/// Readiness Set data structure
+/// 
+/// Note: readiness mask is written by producers, and the rest is private to
+/// the consumer thread.
+/// </summary>
+typedef struct tagNTRINGB_SET {
+	NTRINGB_CACHE_ALIGN LONG64 ready_mask;
+	NTRINGB_CACHE_ALIGN LONG ring_count;
+	LONG last_index;
+	NTRINGB volatile *p_rings[NTRINGB_SET_MAX_COUNT];
+
+} NTRINGB_SET, *PNTRINGB_SET;
+
+/// <summary>
+/// Construct Readiness Set
+/// </summary>
+/// <param name="p_set">A pointer to variable holding readiness set</param>
+void ntringb_set_init(PNTRINGB_SET p_set) {
+	p_set->ready_mask = 0;
+	p_set->ring_count = 0;
+	p_set->last_index = NTRINGB_SET_MAX_COUNT - 1;
+}
+
+/// <summary>
+/// Add ring-buffer to Readiness Set
+/// </summary>
+/// <param name="p_set">A pointer to variable holding readiness set</param>
+/// <param name="p_ringb">A pointer to global (or shared) variable holding ring-buffer</param>
+/// <returns>Index of the ring-buffer in the set, or -1 if the set is full</returns>
+LONG ntringb_set_add(PNTRINGB_SET p_set, NTRINGB volatile *p_ringb) {
+	LONG index;
+
+	if (NTRINGB_SET_MAX_COUNT == p_set->ring_count)
+	{
+		return -1;
+	}
+
+	index = p_set->ring_count++;
+	p_set->p_rings[index] = p_ringb;
+
+	p_ringb->local.ready_bit = (LONG64)1 << index;
+	MemoryBarrier();
+	p_ringb->local.p_ready_mask = &(p_set->ready_mask);
+
+	// Ring-buffer may already hold elements
+	InterlockedOr64(&(p_set->ready_mask), p_ringb->local.ready_bit);
+
+	return index;
+}
+
+/// <summary>
+/// Tell if ring-buffer in Readiness Set has elements committed and not yet reserved by reader
+/// </summary>
+/// <param name="p_set">A pointer to variable holding readiness set</param>
+/// <param name="index">Index of the ring-buffer in the set</param>
+/// <returns>TRUE if ring-buffer has elements, FALSE if ring-buffer is empty</returns>
+BOOL ntringb_set_ring_ready(PNTRINGB_SET p_set, LONG index) {
+	NTRINGB volatile *p_ringb;
+
+	p_ringb = p_set->p_rings[index];
+
+	return 0 < (LONG)(NTRINGB_READ_ACQUIRE(&(p_ringb->state.last_write_pos)) - p_ringb->state.next_read_pos);
+}
+
+/// <summary>
+/// Find lowest set bit of readiness mask
+/// </summary>
+/// <param name="p_index">A pointer to variable receiving index of the bit</param>
+/// <param name="mask">Readiness mask</param>
+/// <returns>TRUE if any bit is set, FALSE otherwise</returns>
+BOOLEAN ntringb_set_scan(ULONG *p_index, ULONG64 mask) {
+#ifdef _M_IX86
+	// BitScanForward64() is not available on x86
+	if (BitScanForward(p_index, (ULONG)mask))
+	{
+		return TRUE;
+	}
+
+	if (BitScanForward(p_index, (ULONG)(mask >> 32)))
+	{
+		*p_index += 32;
+		return TRUE;
+	}
+
+	return FALSE;
+#else
+	return BitScanForward64(p_index, mask);
+#endif
+}
+
+/// <summary>
+/// Find next ring-buffer with elements in Readiness Set
+/// 
+/// Note: search continues round-robin after ring-buffer returned last time, so
+/// busy ring-buffer cannot starve the others. Read from returned ring-buffer
+/// with ntringb_try_begin_read(), since other consumer may take the element.
+/// </summary>
+/// <param name="p_set">A pointer to variable holding readiness set</param>
+/// <returns>Index of the ring-buffer in the set, or -1 if all ring-buffers are empty</returns>
+LONG ntringb_set_next_ready(PNTRINGB_SET p_set) {
+	ULONG64 ready_mask;
+	ULONG index;
+
+	for (;;) {
+		ready_mask = (ULONG64)ReadAcquire64(&(p_set->ready_mask));
+
+		if (!ntringb_set_scan(&index, ready_mask & ((ULONG64)-2 << p_set->last_index)) &&
+			!ntringb_set_scan(&index, ready_mask))
+		{
+			return -1;
+		}
+
+		if (ntringb_set_ring_ready(p_set, (LONG)index))
+		{
+			break;
+		}
+
+		// Clear the bit first, and then check again, so that we don't miss commit
+		// of producer, which saw the bit still set
+		InterlockedAnd64(&(p_set->ready_mask), ~((LONG64)1 << index));
+
+		if (ntringb_set_ring_ready(p_set, (LONG)index))
+		{
+			InterlockedOr64(&(p_set->ready_mask), (LONG64)1 << index);
+			break;
+		}
+	}
+
+	p_set->last_index = (LONG)index;
+	return (LONG)index;
+}
+
+//
+// Deque
+//
+// Note: work-stealing deque (Chase-Lev) is owned by one worker thread, which
+// pushes and pops elements at the bottom without interlocked operations, while
+// other workers steal elements from the top with single compare-exchange. Each
+// worker refills its own deque from the input ring-buffer in batches with
+// ntringb_try_begin_read_n(), and steals from its peers only once its own deque
+// is empty, so that consumers don't all contend on positions of the input ring-buffer.
+// 
+// Deque has fixed capacity, since it does not allocate memory. Owner pops elements
+// in LIFO order, and thieves steal in FIFO order, so there is no ordering between
+// elements processed by different workers.
+//
+
+/// <summary>
+/// Work-Stealing Deque data structure
+/// 
+/// Note: this is control structure, and buffer itself needs to be allocated
+/// separately by the user. Bottom position is written by the owner only, and
+/// top position is advanced by compare-exchange of owner and thieves.
+/// </summary>
+typedef struct tagNTRINGB_DEQUE {
+	NTRINGB_CACHE_ALIGN NTRINGB_SEQ bottom_pos;
+	NTRINGB_CACHE_ALIGN NTRINGB_SEQ top_pos;
+	NTRINGB_CACHE_ALIGN LONG pow2_buffer_count;
+	LONG pow2_buffer_mask;
+
+} NTRINGB_DEQUE, *PNTRINGB_DEQUE;
+
+/// <summary>
+/// Steal Position in Work-Stealing Deque
+/// 
+/// Note: each thief needs its own local steal position, which holds position
+/// of the element between begin and commit of the steal.
+/// </summary>
+typedef struct tagNTRINGB_DEQUE_POS {
+	NTRINGB_DEQUE volatile *p_deque;
+	NTRINGB_SEQ current_pos;
+} NTRINGB_DEQUE_POS, *PNTRINGB_DEQUE_POS;
+
+/// <summary>
+/// Construct Work-Stealing Deque
+/// </summary>
+/// <param name="p_deque">A pointer to global variable holding deque</param>
+/// <param name="pow2_buffer_count">Total count of elements in the deque. Must be power of 2!</param>
+void ntringb_deque_init(NTRINGB_DEQUE volatile *p_deque, LONG pow2_buffer_count) {
+	p_deque->bottom_pos = 0;
+	p_deque->top_pos = 0;
+	p_deque->pow2_buffer_count = pow2_buffer_count;
+	p_deque->pow2_buffer_mask = pow2_buffer_count - 1;
+}
+
+/// <summary>
+/// Contruct Steal Position in the Work-Stealing Deque
+/// </summary>
+/// <param name="p_deque">A pointer to global variable holding deque</param>
+/// <param name="p_result">A pointer to local variable holding steal position</param>
+void ntringb_deque_pos_init(NTRINGB_DEQUE volatile *p_deque, PNTRINGB_DEQUE_POS p_result) {
+	p_result->p_deque = p_deque;
+	p_result->current_pos = 0;
+}
+
+/// <summary>
+/// Tell available space for pushing (owner only)
+/// </summary>
+/// <param name="p_deque">A pointer to global variable holding deque</param>
+/// <returns>Count of spaces available</returns>
+LONG ntringb_deque_available_push(NTRINGB_DEQUE volatile *p_deque) {
+	LONG available = 0;
+
+	available = (LONG)(p_deque->pow2_buffer_count
+		+ NTRINGB_READ_ACQUIRE(&(p_deque->top_pos)) - p_deque->bottom_pos);
+
+	return available;
+}
+
+/// <summary>
+/// Begin pushing multiple elements at the bottom (owner only)
+/// 
+/// Note: elements are written in place, and they become visible to thieves
+/// only once ntringb_deque_commit_push() is called.
+/// </summary>
+/// <param name="p_deque">A pointer to global variable holding deque</param>
+/// <param name="count">Count of elements to push. Must not exceed ntringb_deque_available_push()!</param>
+/// <param name="p_contiguous_count">A pointer to variable receiving count of spaces at returned index before buffer wraps around</param>
+/// <returns>Index of the first space</returns>
+LONG ntringb_deque_begin_push_n(NTRINGB_DEQUE volatile *p_deque, LONG count, PLONG p_contiguous_count) {
+	LONG buffer_pos = 0;
+	LONG contiguous_count = 0;
+
+	buffer_pos = (LONG)(p_deque->bottom_pos & p_deque->pow2_buffer_mask);
+	contiguous_count = p_deque->pow2_buffer_count - buffer_pos;
+	*p_contiguous_count = (count < contiguous_count) ? count : contiguous_count;
+	return buffer_pos;
+}
+
+/// <summary>
+/// Try begin pushing one element at the bottom (owner only)
+/// </summary>
+/// <param name="p_deque">A pointer to global variable holding deque</param>
+/// <param name="p_buffer_pos">A pointer to variable receiving index of the space</param>
+/// <returns>TRUE if space is available, FALSE if deque is full</returns>
+BOOL ntringb_deque_try_begin_push(NTRINGB_DEQUE volatile *p_deque, PLONG p_buffer_pos) {
+	if (ntringb_deque_available_push(p_deque) < 1)
+	{
+		return FALSE;
+	}
+
+	*p_buffer_pos = (LONG)(p_deque->bottom_pos & p_deque->pow2_buffer_mask);
+	return TRUE;
+}
+
+/// <summary>
+/// Commit pushing elements (owner only)
+/// 
+/// Note: this is release store, and no interlocked operation is needed.
+/// </summary>
+/// <param name="p_deque">A pointer to global variable holding deque</param>
+/// <param name="count">Count of elements pushed</param>
+void ntringb_deque_commit_push(NTRINGB_DEQUE volatile *p_deque, LONG count) {
+	NTRINGB_WRITE_RELEASE(&(p_deque->bottom_pos), p_deque->bottom_pos + count);
+}
+
+/// <summary>
+/// Try pop one element from the bottom (owner only)
+/// 
+/// Note: element at returned index belongs to the owner until it pushes again,
+/// and there is nothing to commit. Compare-exchange is needed only when popping
+/// the last element, for which owner may race with thieves.
+/// </summary>
+/// <param name="p_deque">A pointer to global variable holding deque</param>
+/// <param name="p_buffer_pos">A pointer to variable receiving index of the element</param>
+/// <returns>TRUE if element was popped, FALSE if deque is empty</returns>
+BOOL ntringb_deque_try_pop(NTRINGB_DEQUE volatile *p_deque, PLONG p_buffer_pos) {
+	NTRINGB_SEQ bottom_pos;
+	NTRINGB_SEQ top_pos;
+	BOOL result = FALSE;
+
+	bottom_pos = p_deque->bottom_pos - 1;
+	p_deque->bottom_pos = bottom_pos;
+
+	// Thieves must see bottom position taken before we read top position
+	MemoryBarrier();
+
+	top_pos = p_deque->top_pos;
+
+	if (0 < (LONG)(bottom_pos - top_pos))
+	{
+		*p_buffer_pos = (LONG)(bottom_pos & p_deque->pow2_buffer_mask);
+		return TRUE;
+	}
+
+	if (bottom_pos == top_pos)
+	{
+		result = (top_pos == NTRINGB_INTERLOCKED_COMPARE_EXCHANGE(&(p_deque->top_pos), top_pos + 1, top_pos));
+
+		if (result)
+		{
+			*p_buffer_pos = (LONG)(bottom_pos & p_deque->pow2_buffer_mask);
+		}
+	}
+
+	// Deque is empty, so top and bottom positions meet
+	NTRINGB_WRITE_RELEASE(&(p_deque->bottom_pos), bottom_pos + 1);
+	return result;
+}
+
+/// <summary>
+/// Try begin stealing one element from the top
+/// 
+/// Note: thief must copy the element before commit, and use the copy only if
+/// commit succeeds. Element cannot be overwritten by the owner until top
+/// position moves past it.
+/// </summary>
+/// <param name="p_deque_pos">A pointer to local variable holding steal position</param>
+/// <param name="p_buffer_pos">A pointer to variable receiving index of the element</param>
+/// <returns>TRUE if there is element to steal, FALSE if deque is empty</returns>
+BOOL ntringb_deque_try_begin_steal(PNTRINGB_DEQUE_POS p_deque_pos, PLONG p_buffer_pos) {
+	NTRINGB_SEQ top_pos;
+	NTRINGB_SEQ bottom_pos;
+
+	top_pos = NTRINGB_READ_ACQUIRE(&(p_deque_pos->p_deque->top_pos));
+
+	// Top position must be read before bottom position, same as in reverse order in pop
+	MemoryBarrier();
+
+	bottom_pos = NTRINGB_READ_ACQUIRE(&(p_deque_pos->p_deque->bottom_pos));
+
+	if ((LONG)(bottom_pos - top_pos) < 1)
+	{
+		return FALSE;
+	}
+
+	p_deque_pos->current_pos = top_pos;
+	*p_buffer_pos = (LONG)(top_pos & p_deque_pos->p_deque->pow2_buffer_mask);
+	return TRUE;
+}
+
+/// <summary>
+/// Commit stealing one element
+/// </summary>
+/// <param name="p_deque_pos">A pointer to local variable holding steal position</param>
+/// <returns>TRUE if element was stolen, FALSE if owner or other thief took it first, and try again</returns>
+BOOL ntringb_deque_commit_steal(PNTRINGB_DEQUE_POS p_deque_pos) {
+	return (p_deque_pos->current_pos == NTRINGB_INTERLOCKED_COMPARE_EXCHANGE(
+		&(p_deque_pos->p_deque->top_pos),
+		p_deque_pos->current_pos + 1,
+		p_deque_pos->current_pos));
+}
+
+/// <summary>
+/// Try begin stealing one element from any of the peer deques
+/// 
+/// Note: search is round-robin starting at first_index, e.g. index next to the
+/// deque of the calling worker, so that thieves spread over their victims.
+/// Steal position is set to the victim deque, and steal is committed with
+/// ntringb_deque_commit_steal().
+/// </summary>
+/// <param name="pp_deques">A pointer to array of deques of all workers</param>
+/// <param name="deque_count">Count of deques in the array</param>
+/// <param name="first_index">Index of the deque to try first</param>
+/// <param name="p_deque_pos">A pointer to local variable holding steal position</param>
+/// <param name="p_buffer_pos">A pointer to variable receiving index of the element</param>
+/// <returns>Index of the victim deque in the array, or -1 if all deques are empty</returns>
+LONG ntringb_deque_try_begin_steal_any(NTRINGB_DEQUE volatile **pp_deques, LONG deque_count, LONG first_index, PNTRINGB_DEQUE_POS p_deque_pos, PLONG p_buffer_pos) {
+	LONG i;
+	LONG index;
+
+	for (i = 0; i != deque_count; ++i) {
+		index = (first_index + i) % deque_count;
+		p_deque_pos->p_deque = pp_deques[index];
+
+		if (ntringb_deque_try_begin_steal(p_deque_pos, p_buffer_pos))
+		{
+			return index;
+		}
+	}
+
+	return -1;
+}
+
+//
+// Allocation
+//
+// Note: allocation helpers place ring-buffer control structure together with
+// the buffer on large pages on the chosen NUMA node, which should be the node
+// of the consumer. Define NTRINGB_NUMA_ALLOC to enable them. In Kernel Mode
+// they use MmAllocateContiguousNodeMemory(), and in User Mode they use
+// VirtualAllocExNuma() with MEM_LARGE_PAGES (include <Windows.h> first). Large
+// pages in User Mode require SeLockMemoryPrivilege, and without it allocation
+// falls back to regular pages on the same node.
+//
+#ifdef NTRINGB_NUMA_ALLOC
+
+// Size of large page used to round allocation size in Kernel Mode
+#ifndef NTRINGB_LARGE_PAGE_SIZE
+#define NTRINGB_LARGE_PAGE_SIZE (2 * 1024 * 1024)
+#endif
+
+// Special value of NUMA node standing for node of the calling thread
+#define NTRINGB_NUMA_NODE_CURRENT ((ULONG)-1)
+
+/// <summary>
+/// Ring-Buffer Allocation data structure
+/// 
+/// Note: buffer starts on the cache line following control structure.
+/// </summary>
+typedef struct tagNTRINGB_ALLOCATION {
+	NTRINGB volatile *p_ringb;
+	PVOID p_buffer;
+	SIZE_T size;
+	BOOLEAN large_pages;
+} NTRINGB_ALLOCATION, *PNTRINGB_ALLOCATION;
+
+/// <summary>
+/// Tell NUMA node of the calling thread
+/// </summary>
+/// <returns>NUMA node number</returns>
+ULONG ntringb_current_numa_node(void) {
+#ifdef _KERNEL_MODE
+	return (ULONG)KeGetCurrentNodeNumber();
+#else
+	PROCESSOR_NUMBER processor_number;
+	USHORT node_number = 0;
+
+	GetCurrentProcessorNumberEx(&processor_number);
+	GetNumaProcessorNodeEx(&processor_number, &node_number);
+
+	return (ULONG)node_number;
+#endif
+}
+
+/// <summary>
+/// Allocate and construct Ring-Buffer together with its buffer on large pages
+/// </summary>
+/// <param name="pow2_buffer_count">Total count of elements in the ring-buffer. Must be power of 2!</param>
+/// <param name="element_size">Size of one element of the buffer</param>
+/// <param name="numa_node">NUMA node to allocate memory on, or NTRINGB_NUMA_NODE_CURRENT</param>
+/// <param name="p_result">A pointer to variable receiving the allocation</param>
+/// <returns>TRUE if all went well, FALSE if memory allocation failed</returns>
+BOOL ntringb_numa_alloc(LONG pow2_buffer_count, SIZE_T element_size, ULONG numa_node, PNTRINGB_ALLOCATION p_result) {
+	SIZE_T header_size;
+	SIZE_T page_size;
+	PUCHAR p_memory;
+
+	if (NTRINGB_NUMA_NODE_CURRENT == numa_node)
+	{
+		numa_node = ntringb_current_numa_node();
+	}
+
+	header_size = (sizeof(NTRINGB) + NTRINGB_CACHE_LINE_SIZE - 1) & ~((SIZE_T)NTRINGB_CACHE_LINE_SIZE - 1);
+	p_result->size = header_size + element_size * (SIZE_T)pow2_buffer_count;
+
+#ifdef _KERNEL_MODE
+	{
+		PHYSICAL_ADDRESS lowest_address;
+		PHYSICAL_ADDRESS highest_address;
+		PHYSICAL_ADDRESS boundary_address;
+
+		lowest_address.QuadPart = 0;
+		highest_address.QuadPart = MAXLONGLONG;
+		boundary_address.QuadPart = 0;
+
+		// Physically contiguous memory is mapped with large pages where possible
+		page_size = NTRINGB_LARGE_PAGE_SIZE;
+		p_result->size = (p_result->size + page_size - 1) & ~(page_size - 1);
+		p_result->large_pages = TRUE;
+
+		p_memory = (PUCHAR)MmAllocateContiguousNodeMemory(p_result->size,
+			lowest_address, highest_address, boundary_address, PAGE_READWRITE, numa_node);
+	}
+#else
+	page_size = GetLargePageMinimum();
+	p_memory = NULL;
+
+	if (0 != page_size)
+	{
+		p_result->size = (p_result->size + page_size - 1) & ~(page_size - 1);
+		p_result->large_pages = TRUE;
+
+		p_memory = (PUCHAR)VirtualAllocExNuma(GetCurrentProcess(), NULL, p_result->size,
+			MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE, numa_node);
+	}
+
+	if (NULL == p_memory)
+	{
+		p_result->large_pages = FALSE;
+
+		p_memory = (PUCHAR)VirtualAllocExNuma(GetCurrentProcess(), NULL, p_result->size,
+			MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE, numa_node);
+	}
+#endif
+
+	if (NULL == p_memory)
+	{
+		p_result->p_ringb = NULL;
+		p_result->p_buffer = NULL;
+		return FALSE;
+	}
+
+	p_result->p_ringb = (NTRINGB volatile *)p_memory;
+	p_result->p_buffer = (PVOID)(p_memory + header_size);
+
+	ntringb_init(p_result->p_ringb, pow2_buffer_count);
+	return TRUE;
+}
+
+/// <summary>
+/// Free Ring-Buffer allocated with ntringb_numa_alloc()
+/// </summary>
+/// <param name="p_allocation">A pointer to variable holding the allocation</param>
+void ntringb_numa_free(PNTRINGB_ALLOCATION p_allocation) {
+	if (NULL == p_allocation->p_ringb)
+	{
+		return;
+	}
+
+#ifdef _KERNEL_MODE
+	MmFreeContiguousMemory((PVOID)p_allocation->p_ringb);
+#else
+	VirtualFree((PVOID)p_allocation->p_ringb, 0, MEM_RELEASE);
+#endif
+
+	p_allocation->p_ringb = NULL;
+	p_allocation->p_buffer = NULL;
+}
+#endif
+
+//
+// Shared
+//
+// Note: shared ring-buffer lives in memory section mapped into more than one
+// address space, e.g. into driver and into user process, so that kernel-mode
+// producer and user-mode consumer share one ring-buffer without system calls.
+// Mapping holds only NTRINGB_STATE, which has positions, counters and flags,
+// and header with buffer offset, and no pointers, so that it is valid at any
+// address. Each side keeps its own view with local address of the mapping, with
+// private copy of the mask, and with its own NTRINGB_LOCAL. Stream positions are
+// local to each thread, and they point to control state in local mapping, and
+// to local state in the view, so that pointers and masks are never read from
+// the mapping.
+// 
+// Each side validates the shared header when attaching, and addresses elements
+// with its private copy of the mask, so that corrupted header cannot make the
+// driver access memory outside of the mapping. Driver should use poll and try
+// functions, so that it cannot be stalled by misbehaving process. Readiness set,
+// statistics, skip and parking are local to one address space, and cannot be
+// used with shared ring-buffer, unless NTRINGB_PARK uses named event.
+//
+
+// Signature of shared ring-buffer header
+#define NTRINGB_SHARED_MAGIC 0x4252544E
+
+/// <summary>
+/// Shared Ring-Buffer data structure
+/// 
+/// Note: ringb_size is size of NTRINGB_STATE and it must match on both sides, i.e.
+/// both sides must use same NTRINGB_PADDED and NTRINGB_SEQ64. Buffer starts at
+/// buffer_offset, right after this structure, which is multiple of cache line size.
+/// </summary>
+typedef struct tagNTRINGB_SHARED {
+	LONG magic;
+	LONG ringb_size;
+	LONG element_size;
+	LONG buffer_offset;
+	DECLSPEC_ALIGN(NTRINGB_CACHE_LINE_SIZE) NTRINGB_STATE ringb;
+
+} NTRINGB_SHARED, *PNTRINGB_SHARED;
+
+/// <summary>
+/// View of Shared Ring-Buffer in local address space
+/// 
+/// Note: local is local state used by stream positions of this side, as mapping
+/// holds control state only. Mask is private copy, which is validated on attach.
+/// </summary>
+typedef struct tagNTRINGB_SHARED_VIEW {
+	NTRINGB_SHARED volatile *p_shared;
+	PUCHAR p_buffer;
+	LONG element_size;
+	LONG pow2_buffer_mask;
+	NTRINGB_LOCAL local;
+} NTRINGB_SHARED_VIEW, *PNTRINGB_SHARED_VIEW;
+
+// Special macro returning pointer to element at index in local view of shared ring-buffer
+#define NTRINGB_SHARED_PELEMENT(p_view, buffer_pos) ((PVOID)((p_view)->p_buffer + \
+	(SIZE_T)((buffer_pos) & (p_view)->pow2_buffer_mask) * (SIZE_T)(p_view)->element_size))
+
+/// <summary>
+/// Tell size of memory section needed for Shared Ring-Buffer
+/// </summary>
+/// <param name="pow2_buffer_count">Total count of elements in the ring-buffer. Must be power of 2!</param>
+/// <param name="element_size">Size of one element of the buffer</param>
+/// <returns>Size of memory section in bytes</returns>
+SIZE_T ntringb_shared_size(LONG pow2_buffer_count, LONG element_size) {
+	return sizeof(NTRINGB_SHARED) + (SIZE_T)pow2_buffer_count * (SIZE_T)element_size;
+}
+
+/// <summary>
+/// Construct Shared Ring-Buffer in memory section, and its local view
+/// </summary>
+/// <param name="p_memory">A pointer to local mapping of memory section of ntringb_shared_size() bytes, aligned to NTRINGB_CACHE_LINE_SIZE</param>
+/// <param name="pow2_buffer_count">Total count of elements in the ring-buffer. Must be power of 2!</param>
+/// <param name="element_size">Size of one element of the buffer</param>
+/// <param name="p_result">A pointer to variable receiving local view</param>
+void ntringb_shared_init(PVOID p_memory, LONG pow2_buffer_count, LONG element_size, PNTRINGB_SHARED_VIEW p_result) {
+	NTRINGB_SHARED volatile *p_shared = (NTRINGB_SHARED volatile *)p_memory;
+
+	p_shared->ringb_size = (LONG)sizeof(NTRINGB_STATE);
+	p_shared->element_size = element_size;
+	p_shared->buffer_offset = (LONG)sizeof(NTRINGB_SHARED);
+
+	ntringb_state_init(&(p_shared->ringb), pow2_buffer_count);
+
+	// Header must be complete before other side can see the signature
+	MemoryBarrier();
+	p_shared->magic = NTRINGB_SHARED_MAGIC;
+
+	p_result->p_shared = p_shared;
+	p_result->p_buffer = (PUCHAR)p_memory + sizeof(NTRINGB_SHARED);
+	p_result->element_size = element_size;
+	p_result->pow2_buffer_mask = pow2_buffer_count - 1;
+	ntringb_local_init(&(p_result->local));
+}
+
+/// <summary>
+/// Attach to Shared Ring-Buffer constructed by other side, and construct its local view
+/// </summary>
+/// <param name="p_memory">A pointer to local mapping of memory section</param>
+/// <param name="memory_size">Size of local mapping of memory section</param>
+/// <param name="element_size">Expected size of one element of the buffer</param>
+/// <param name="p_result">A pointer to variable receiving local view</param>
+/// <returns>TRUE if shared header is valid, FALSE otherwise</returns>
+BOOL ntringb_shared_attach(PVOID p_memory, SIZE_T memory_size, LONG element_size, PNTRINGB_SHARED_VIEW p_result) {
+	NTRINGB_SHARED volatile *p_shared = (NTRINGB_SHARED volatile *)p_memory;
+	LONG pow2_buffer_count;
+
+	if (memory_size < sizeof(NTRINGB_SHARED) || NTRINGB_SHARED_MAGIC != p_shared->magic)
+	{
+		return FALSE;
+	}
+
+	MemoryBarrier();
+	pow2_buffer_count = p_shared->ringb.pow2_buffer_count;
+
+	if ((LONG)sizeof(NTRINGB_STATE) != p_shared->ringb_size
+		|| element_size != p_shared->element_size
+		|| (LONG)sizeof(NTRINGB_SHARED) != p_shared->buffer_offset
+		|| pow2_buffer_count < 1
+		|| 0 != (pow2_buffer_count & (pow2_buffer_count - 1))
+		|| memory_size < ntringb_shared_size(pow2_buffer_count, element_size))
+	{
+		return FALSE;
+	}
+
+	p_result->p_shared = p_shared;
+	p_result->p_buffer = (PUCHAR)p_memory + sizeof(NTRINGB_SHARED);
+	p_result->element_size = element_size;
+	p_result->pow2_buffer_mask = pow2_buffer_count - 1;
+	ntringb_local_init(&(p_result->local));
+	return TRUE;
+}
+
+/// <summary>
+/// Contruct Stream Position in the Shared Ring-Buffer
+/// </summary>
+/// <param name="p_view">A pointer to variable holding local view of shared ring-buffer</param>
+/// <param name="p_result">A pointer to local variable holding ring-buffer stream position</param>
+void ntringb_shared_pos_init(PNTRINGB_SHARED_VIEW p_view, PNTRINGB_POS p_result) {
+	p_result->p_ringb = &(p_view->p_shared->ringb);
+	p_result->p_local = &(p_view->local);
+	p_result->current_pos = -1;
+	p_result->current_count = 0;
+	p_result->pow2_buffer_count = p_view->pow2_buffer_mask + 1;
+	p_result->pow2_buffer_mask = p_view->pow2_buffer_mask;
+#ifdef NTRINGB_COLLECT_STATS
+	p_result->p_stats = NULL;
+#endif
+}
+
+/// <summary>
+/// Close Shared Ring-Buffer, and wake readers and writers of this side
+/// </summary>
+/// <param name="p_view">A pointer to variable holding local view of shared ring-buffer</param>
+void ntringb_shared_close(PNTRINGB_SHARED_VIEW p_view) {
+	ntringb_state_close(&(p_view->p_shared->ringb));
+}
+
+#ifdef NTRINGB_RECORD_TAP
+//
+// Tap
+//
+// Note: tap records elements committed to ring-buffer into recording ring-buffer,
+// which is usually NTRINGB_SHARED mapped into capture process, so that stream can
+// be captured in production, and replayed later, e.g. into benchmark. Capture
+// process reads records with ntringb_shared_pos_init() and ntringb_try_begin_read().
+// Tap costs writers one copy of each element, and blocking of writers is never
+// caused by recording. Abandoned elements are recorded with NTRINGB_TAP_ABANDONED
+// flag and without copy. Tap of shared ring-buffer is attached to local view with
+// ntringb_shared_tap_attach(), as local state is never read from the mapping.
+//
+
+/// <summary>
+/// Construct Tap
+/// 
+/// Note: masks are taken from pow2_buffer_count and from local view of recording
+/// ring-buffer, and never from control structures, which may be in the mapping.
+/// 
+/// Note: sequences of free records are set, so that they don't look complete.
+/// Construct tap before it is attached, and not while other tap records into the
+/// same recording ring-buffer.
+/// </summary>
+/// <param name="p_tap">A pointer to global variable holding tap</param>
+/// <param name="p_source_buffer">A pointer to buffer of ring-buffer being tapped</param>
+/// <param name="element_size">Size of one element of the buffer</param>
+/// <param name="pow2_buffer_count">Count of elements of the buffer. Must be power of 2!</param>
+/// <param name="p_recording">A pointer to local view of shared ring-buffer with records of NTRINGB_TAP_RECORD_SIZE(element_size) bytes</param>
+/// <returns>TRUE if tap was constructed, FALSE if record size of recording ring-buffer does not match</returns>
+BOOL ntringb_tap_init(PNTRINGB_TAP p_tap, PVOID p_source_buffer, LONG element_size, LONG pow2_buffer_count, PNTRINGB_SHARED_VIEW p_recording) {
+	NTRINGB_SEQ pos;
+
+	if (NTRINGB_TAP_RECORD_SIZE(element_size) != p_recording->element_size)
+	{
+		return FALSE;
+	}
+
+	p_tap->p_recorder = &(p_recording->p_shared->ringb);
+	p_tap->p_record_buffer = p_recording->p_buffer;
+	p_tap->p_source_buffer = (PUCHAR)p_source_buffer;
+	p_tap->element_size = element_size;
+	p_tap->record_size = p_recording->element_size;
+	p_tap->record_count = p_recording->pow2_buffer_mask + 1;
+	p_tap->record_mask = p_recording->pow2_buffer_mask;
+	p_tap->source_mask = pow2_buffer_count - 1;
+	p_tap->drop_count = 0;
+
+	// Sequence of each free record is position of the record before it in the same slot
+	for (pos = p_tap->p_recorder->next_write_pos + 1;
+		pos != NTRINGB_READ_ACQUIRE(&(p_tap->p_recorder->last_read_pos)) + p_tap->record_count + 1; ++pos) {
+		NTRINGB_TAP_PHEADER(p_tap, pos)->sequence = (LONG)(pos - p_tap->record_count);
+	}
+
+	MemoryBarrier();
+	return TRUE;
+}
+
+/// <summary>
+/// Replace Tap in local state of Ring-Buffer
+/// </summary>
+/// <param name="p_local">A pointer to local state of ring-buffer</param>
+/// <param name="p_tap">A pointer to constructed tap, or NULL to detach tap</param>
+/// <returns>Count of elements that were dropped from recording by tap that was replaced, or zero if there was none</returns>
+LONG ntringb_tap_exchange(NTRINGB_LOCAL volatile *p_local, PNTRINGB_TAP p_tap) {
+	PNTRINGB_TAP p_previous = p_local->p_tap;
+
+	// Tap must be complete before writers can see it
+	MemoryBarrier();
+	p_local->p_tap = p_tap;
+	MemoryBarrier();
+
+	if (NULL == p_previous)
+	{
+		return 0;
+	}
+
+	return ReadAcquire(&(p_previous->drop_count));
+}
+
+/// <summary>
+/// Attach Tap to Ring-Buffer
+/// 
+/// Note: tap must outlive any commit that started while it was attached, so
+/// detach it with ntringb_tap_detach() only once writers are stopped.
+/// </summary>
+/// <param name="p_ringb">A pointer to global variable holding ring-buffer</param>
+/// <param name="p_tap">A pointer to global variable holding tap</param>
+/// <param name="p_source_buffer">A pointer to buffer of ring-buffer being tapped</param>
+/// <param name="element_size">Size of one element of the buffer</param>
+/// <param name="p_recording">A pointer to local view of shared ring-buffer with records of NTRINGB_TAP_RECORD_SIZE(element_size) bytes</param>
+/// <returns>TRUE if tap was attached, FALSE if record size of recording ring-buffer does not match</returns>
+BOOL ntringb_tap_attach(NTRINGB volatile *p_ringb, PNTRINGB_TAP p_tap, PVOID p_source_buffer, LONG element_size, PNTRINGB_SHARED_VIEW p_recording) {
+	if (!ntringb_tap_init(p_tap, p_source_buffer, element_size, p_ringb->state.pow2_buffer_count, p_recording))
+	{
+		return FALSE;
+	}
+
+	ntringb_tap_exchange(&(p_ringb->local), p_tap);
+	return TRUE;
+}
+
+/// <summary>
+/// Detach Tap from Ring-Buffer
+/// </summary>
+/// <param name="p_ringb">A pointer to global variable holding ring-buffer</param>
+/// <returns>Count of elements that were dropped from recording</returns>
+LONG ntringb_tap_detach(NTRINGB volatile *p_ringb) {
+	return ntringb_tap_exchange(&(p_ringb->local), NULL);
+}
+
+/// <summary>
+/// Attach Tap to Shared Ring-Buffer
+/// 
+/// Note: tap is attached to local view, so that it only records elements
+/// committed with stream positions of this side.
+/// </summary>
+/// <param name="p_view">A pointer to variable holding local view of shared ring-buffer being tapped</param>
+/// <param name="p_tap">A pointer to global variable holding tap</param>
+/// <param name="p_recording">A pointer to local view of shared ring-buffer with records of NTRINGB_TAP_RECORD_SIZE(element_size) bytes</param>
+/// <returns>TRUE if tap was attached, FALSE if record size of recording ring-buffer does not match</returns>
+BOOL ntringb_shared_tap_attach(PNTRINGB_SHARED_VIEW p_view, PNTRINGB_TAP p_tap, PNTRINGB_SHARED_VIEW p_recording) {
+	if (!ntringb_tap_init(p_tap, p_view->p_buffer, p_view->element_size, p_view->pow2_buffer_mask + 1, p_recording))
+	{
+		return FALSE;
+	}
+
+	ntringb_tap_exchange(&(p_view->local), p_tap);
+	return TRUE;
+}
+
+/// <summary>
+/// Detach Tap from Shared Ring-Buffer
+/// </summary>
+/// <param name="p_view">A pointer to variable holding local view of shared ring-buffer being tapped</param>
+/// <returns>Count of elements that were dropped from recording</returns>
+LONG ntringb_shared_tap_detach(PNTRINGB_SHARED_VIEW p_view) {
+	return ntringb_tap_exchange(&(p_view->local), NULL);
+}
+#endif
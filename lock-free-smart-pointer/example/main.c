@@ -36,7 +36,7 @@ void foo_destroy(PVOID p_context, PNTARC p_arc)
         return;
     }
 
-    free((PVOID)(p_arc->p_data));
+    // Foo was allocated together with control block
     free((PVOID)(p_arc->p_control_block));
 
     p_arc->p_data = 0;
@@ -53,36 +53,28 @@ void foo_destroy(PVOID p_context, PNTARC p_arc)
 BOOL foo_new(PNTARC p_arc, int x, int y)
 {
     PFOO p_foo = NULL;
-    PNTARC_CONTROL_BLOCK p_control_block = NULL;
+    PVOID p_allocation = NULL;
 
     if (p_arc == NULL) {
         goto bail010;
     }
 
-    // Allocate memory for (our) Foo
-    p_foo = (PFOO)malloc(sizeof(FOO));
-    if (p_foo == 0) {
+    // Allocate memory for (ntarc) Control Block and (our) Foo at once
+    p_allocation = malloc(NTARC_INLINE_SIZE(sizeof(FOO), TYPE_ALIGNMENT(FOO)));
+    if (p_allocation == 0) {
         goto bail020;
     }
 
-    // Allocate memory for (ntarc) Control Block
-    p_control_block = (PNTARC_CONTROL_BLOCK)malloc(sizeof(NTARC_CONTROL_BLOCK));
-    if (p_control_block == 0) {
-        goto bail030;
-    }
+    // Init (ntarc) ARC
+    p_foo = (PFOO)ntarc_new_inline(p_allocation, TYPE_ALIGNMENT(FOO), NULL, &foo_destroy, p_arc);
 
     // Init (our) Foo
     memset((PVOID)p_foo, 0, sizeof(FOO));
     p_foo->x = x;
     p_foo->y = y;
-
-    // Init (ntarc) ARC
-    ntarc_new((PVOID)p_foo, NULL, &foo_destroy, p_control_block, p_arc);
     
     return TRUE;
 
-bail030:
-    free((PVOID)p_foo);
 bail020:
 bail010:
     return FALSE;
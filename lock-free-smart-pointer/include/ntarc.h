@@ -1,10 +1,41 @@
 // 
 // NTARC is header-only C library that can be used in Windows Kernel Mode
 // 
+// On other than Windows targets it builds with GCC or Clang using portable atomics
+// for x86-64 and ARM64 from ntportable.h (lock-free-portable/include).
+// 
 // NOTE
 // ====
 //   NTARC is Lock-Free implementation of Atomic Shared Pointer
 //
+//   Atomic Load does not write to the shared variable. Readers protect control
+//   block with hazard slot, and the last drop of an object waits until no reader
+//   holds it in hazard slot.
+//
+//   Destruction of an object can be deferred to Reclaim Domain, so that the thread
+//   dropping last reference does not run the destructor. Destructors of retired
+//   objects run later when ntarc_reclaim() is called, e.g. from background thread.
+//
+//   ARC can be allocated from Pool of fixed-size blocks, which is lock-free list
+//   of free blocks using 128-bit CAS of pointer and tag.
+//
+//   Weak reference keeps control block alive, but not the object. Destructor of the
+//   object runs on last drop of ARC, and control block is freed on last drop of ARC
+//   or weak reference, whichever is later.
+//
+//   Borrow reads shared ARC without touching reference count, and reference count
+//   can be changed by many references in single interlocked operation.
+//
+//   Versioned ARC has generation counter incremented on every store, so that thread
+//   can keep cached clone of it, and reload it only when generation has changed.
+//
+//   Atomic Compare Exchange stores new ARC only if shared variable still holds expected
+//   ARC, so that many writers can publish copy-on-write updates without a lock.
+//
+//   Queue and Stack hand off intrusive nodes carrying ARC without capacity limit, and
+//   without allocation. Queue is MPSC linked list, and Stack is ABA-safe list using
+//   128-bit CAS of pointer and tag, same as Pool.
+//
 // LICENSE
 // =======
 //   The MIT License(MIT) Copyright(c) 2024, Sadhbh C0d3
@@ -29,7 +60,76 @@
 
 #pragma once
 
+#ifdef _WIN32
 #include <winnt.h>
+#else
+#include "ntportable.h"
+#endif
+
+// Size of the cache line used to separate hazard slots
+#ifndef NTARC_CACHE_LINE_SIZE
+#define NTARC_CACHE_LINE_SIZE 64
+#endif
+
+// Count of hazard slots used by Atomic Load. Reader starts searching for free slot
+// at index of its processor, so the count should not be less than count of processors.
+#ifndef NTARC_HAZARD_COUNT
+#define NTARC_HAZARD_COUNT 64
+#endif
+
+// Index of processor of the calling thread (in User Mode include <Windows.h> first)
+#ifndef NTARC_CURRENT_PROCESSOR
+#if defined(_KERNEL_MODE)
+#define NTARC_CURRENT_PROCESSOR() KeGetCurrentProcessorIndex()
+#elif defined(_WIN32)
+#define NTARC_CURRENT_PROCESSOR() GetCurrentProcessorNumber()
+#elif defined(__linux__)
+// Declared by <sched.h>, which ntportable.h includes with _GNU_SOURCE
+#define NTARC_CURRENT_PROCESSOR() ((ULONG)sched_getcpu())
+#else
+#define NTARC_CURRENT_PROCESSOR() 0
+#endif
+#endif
+
+// Assertion of conditions, under which caller would wait forever (in User Mode it is assert())
+#ifndef NTARC_ASSERT
+#if defined(_KERNEL_MODE)
+#define NTARC_ASSERT(expression) NT_ASSERT(expression)
+#else
+#include <assert.h>
+#define NTARC_ASSERT(expression) assert(expression)
+#endif
+#endif
+
+// Record owner thread in hazard slot, so that last drop asserts when it would wait
+// for hazard slot of its own thread, e.g. when thread drops ARC it still borrows
+#ifndef NTARC_CHECK_HAZARD
+#if (defined(DBG) && DBG) || defined(_DEBUG)
+#define NTARC_CHECK_HAZARD
+#endif
+#endif
+
+// Identifier of the calling thread, used only with NTARC_CHECK_HAZARD
+#if defined(NTARC_CHECK_HAZARD) && !defined(NTARC_CURRENT_THREAD)
+#if defined(_KERNEL_MODE)
+#define NTARC_CURRENT_THREAD() ((LONG64)(ULONG_PTR)PsGetCurrentThreadId())
+#elif defined(_WIN32)
+#define NTARC_CURRENT_THREAD() ((LONG64)GetCurrentThreadId())
+#else
+#include <pthread.h>
+#define NTARC_CURRENT_THREAD() ((LONG64)pthread_self())
+#endif
+#endif
+
+// Atomic Load, Borrow and last drop of stored ARC spin, so in Kernel Mode they must not
+// be called above DISPATCH_LEVEL. Last drop called at DISPATCH_LEVEL waits for readers,
+// so then readers must also run at DISPATCH_LEVEL, as reader preempted on the same
+// processor would never release its hazard slot.
+#if defined(_KERNEL_MODE)
+#define NTARC_ASSERT_SPIN_IRQL() NTARC_ASSERT(KeGetCurrentIrql() <= DISPATCH_LEVEL)
+#else
+#define NTARC_ASSERT_SPIN_IRQL()
+#endif
 
 /// <summary>
 /// ARC data structure.
@@ -47,31 +147,257 @@ typedef struct tagNTARC {
 /// </summary>
 typedef  void (*PFN_NTARC_DESTROY)(PVOID, PNTARC);
 
+/// <summary>
+/// Update function that user supplies to Atomic Update. It receives user-supplied
+/// context, current ARC, and variable receiving new ARC, and it returns FALSE to
+/// cancel update.
+/// </summary>
+typedef BOOLEAN (*PFN_NTARC_UPDATE)(PVOID, PNTARC, PNTARC);
+
+/// <summary>
+/// Pool data structure.
+/// 
+/// Holds list of free fixed-size blocks in user-supplied memory. Head of the
+/// list is pointer to first free block followed by tag, which is incremented
+/// on every change, so that CAS fails if head was popped and pushed back.
+/// 
+/// Must be aligned to 16 bytes because of 128-bit CAS !!!
+/// </summary>
+typedef struct tagNTARC_POOL {
+    DECLSPEC_ALIGN(NTARC_CACHE_LINE_SIZE) volatile LONG64 free_list[2];
+    SIZE_T block_size;
+    LONG block_count;
+
+} NTARC_POOL, *PNTARC_POOL;
+
+/// <summary>
+/// Weak reference data structure.
+/// 
+/// Same layout as ARC, but it does not own the object, and it
+/// must be upgraded to ARC before the object can be used.
+/// </summary>
+typedef struct tagNTARC_WEAK {
+    LONG64 p_control_block;
+    LONG64 p_data;
+
+} NTARC_WEAK, *PNTARC_WEAK;
+
+/// <summary>
+/// Borrowed ARC data structure.
+/// 
+/// Holds shared ARC without reference, protected by hazard slot, or
+/// with reference if all hazard slots were taken.
+/// </summary>
+typedef struct tagNTARC_BORROW {
+    NTARC arc;
+    LONG hazard_index;
+
+} NTARC_BORROW, *PNTARC_BORROW;
+
+// Hazard index of borrowed ARC holding reference instead of hazard slot
+#define NTARC_BORROW_REFERENCE (-2)
+
+/// <summary>
+/// Versioned ARC data structure.
+/// 
+/// Holds shared ARC, and generation that is incremented after
+/// every store.
+/// 
+/// Must be aligned to 16 bytes because of 128-bit CAS !!!
+/// </summary>
+typedef struct tagNTARC_VERSIONED {
+    NTARC arc;
+    volatile LONG64 generation;
+
+} NTARC_VERSIONED, *PNTARC_VERSIONED;
+
+/// <summary>
+/// Cached ARC data structure.
+/// 
+/// Holds clone of Versioned ARC, and generation at which it was
+/// loaded. Each thread has its own.
+/// </summary>
+typedef struct tagNTARC_CACHE {
+    NTARC arc;
+    LONG64 generation;
+
+} NTARC_CACHE, *PNTARC_CACHE;
+
+/// <summary>
+/// Reclaim Domain data structure.
+/// 
+/// Holds list of retired control blocks, which are objects that lost their
+/// last reference, and their destructors did not run yet.
+/// </summary>
+typedef struct tagNTARC_RECLAIM {
+    DECLSPEC_ALIGN(NTARC_CACHE_LINE_SIZE) volatile LONG64 p_retired;
+    volatile LONG retired_count;
+
+} NTARC_RECLAIM, *PNTARC_RECLAIM;
+
+/// <summary>
+/// Node data structure.
+/// 
+/// Intrusive link of Queue and Stack, which carries ARC. Node can be embedded in
+/// user-defined data, and then ARC of that data keeps it alive while it is linked.
+/// </summary>
+typedef struct tagNTARC_NODE {
+    volatile LONG64 p_next;
+    NTARC arc;
+
+} NTARC_NODE, *PNTARC_NODE;
+
+/// <summary>
+/// Queue data structure.
+/// 
+/// MPSC list of nodes, where producers swap head, and single consumer follows
+/// tail. Stub node stays in the Queue, so that it is never empty list.
+/// </summary>
+typedef struct tagNTARC_QUEUE {
+    DECLSPEC_ALIGN(NTARC_CACHE_LINE_SIZE) volatile LONG64 p_head;
+    DECLSPEC_ALIGN(NTARC_CACHE_LINE_SIZE) LONG64 p_tail;
+    NTARC_NODE stub;
+
+} NTARC_QUEUE, *PNTARC_QUEUE;
+
+/// <summary>
+/// Stack data structure.
+/// 
+/// Top of the stack is pointer to first node followed by tag, which is
+/// incremented on every change, so that CAS fails if top was popped and
+/// pushed back.
+/// 
+/// Must be aligned to 16 bytes because of 128-bit CAS !!!
+/// </summary>
+typedef struct tagNTARC_STACK {
+    DECLSPEC_ALIGN(NTARC_CACHE_LINE_SIZE) volatile LONG64 top[2];
+
+} NTARC_STACK, *PNTARC_STACK;
+
 /// <summary>
 /// ARC Control Block data structure.
 /// 
 /// Contains reference count, and user-defined destructor
 /// with user-supplied context.
+/// 
+/// Store version is incremented every time the ARC is removed from
+/// shared variable, so that Atomic Load can tell that the variable
+/// changed while it was reading it, and last drop scans hazard slots
+/// only if ARC was ever stored.
+/// 
+/// If Reclaim Domain is set, then last drop puts control block
+/// onto retired list of the domain instead of calling destructor.
+/// 
+/// Weak count is count of weak references plus one for all ARCs.
+/// If Free Function is set, then destructor only destructs user-defined
+/// data, and Free Function frees control block when weak count drops
+/// to zero. Otherwise destructor frees all, and weak references cannot
+/// be used.
 /// </summary>
 typedef struct tagNTARC_CONTROL_BLOCK {
     volatile LONG reference_count;
+    volatile LONG store_version;
+    volatile LONG weak_count;
     PVOID p_destroy_context;
     PFN_NTARC_DESTROY pfn_destroy;
+    void (*pfn_free)(PVOID, struct tagNTARC_CONTROL_BLOCK*);
+    PNTARC_RECLAIM p_reclaim;
+    LONG64 p_retired_next;
+    LONG64 p_retired_data;
 
 } NTARC_CONTROL_BLOCK, *PNTARC_CONTROL_BLOCK;
 
+/// <summary>
+/// Free Function that user may supply to free control block
+/// </summary>
+typedef void (*PFN_NTARC_FREE)(PVOID, PNTARC_CONTROL_BLOCK);
+
 // Special macros for extraction of user-defined data and ARC control block
 #define NTARC_PDATA(p_chunk, USERTYPE) ((USERTYPE*)(p_chunk->p_data))
 #define NTARC_PCONTROL_BLOCK(p_chunk) ((PNTARC_CONTROL_BLOCK)(p_chunk->p_control_block))
 #define NTARC_PREFCOUNT(p_chunk) (&(NTARC_PCONTROL_BLOCK(p_chunk)->reference_count))
+#define NTARC_PSTORE_VERSION(p_chunk) (&(NTARC_PCONTROL_BLOCK(p_chunk)->store_version))
 #define NTARC_PDESTROY_CONTEXT(p_chunk) (&(NTARC_PCONTROL_BLOCK(p_chunk)->p_destroy_context))
 #define NTARC_PFNDESTROY(p_chunk) (&(NTARC_PCONTROL_BLOCK(p_chunk)->pfn_destroy))
+#define NTARC_PWEAKCOUNT(p_chunk) (&(NTARC_PCONTROL_BLOCK(p_chunk)->weak_count))
+// Macros for single allocation holding ARC control block followed by user-defined data,
+// where alignment must be power of 2, and allocation must be aligned to it
+#define NTARC_INLINE_DATA_OFFSET(alignment) ((sizeof(NTARC_CONTROL_BLOCK) + (SIZE_T)(alignment) - 1) & ~((SIZE_T)(alignment) - 1))
+#define NTARC_INLINE_SIZE(data_size, alignment) (NTARC_INLINE_DATA_OFFSET(alignment) + (SIZE_T)(data_size))
+#define NTARC_INLINE_PDATA(p_control_block, alignment) ((PVOID)((PUCHAR)(p_control_block) + NTARC_INLINE_DATA_OFFSET(alignment)))
 #define NTARC_LOW(chunk) (chunk.p_control_block)
 #define NTARC_HIGH(chunk) (chunk.p_data)
 #define NTARC_COMPARE_EXCHANGE(p_store, new_value, old_value) (InterlockedCompareExchange128((volatile LONG64*)p_store, \
     NTARC_HIGH(new_value), NTARC_LOW(new_value) , \
     (LONG64*)&(old_value)))
 
+/// <summary>
+/// Hazard slot data structure.
+/// 
+/// Holds control block that reader is about to clone, and it is
+/// on its own cache line.
+/// </summary>
+typedef struct tagNTARC_HAZARD {
+    DECLSPEC_ALIGN(NTARC_CACHE_LINE_SIZE) volatile LONG64 p_control_block;
+#ifdef NTARC_CHECK_HAZARD
+    volatile LONG64 owner_thread;
+#endif
+
+} NTARC_HAZARD, *PNTARC_HAZARD;
+
+/// <summary>
+/// Hazard slots shared by all readers
+/// 
+/// Note: selectany (weak) definition, so that every translation unit including
+/// this header refers to the same slots.
+/// </summary>
+DECLSPEC_SELECTANY NTARC_HAZARD g_ntarc_hazards[NTARC_HAZARD_COUNT] = {0};
+
+/// <summary>
+/// Acquire free hazard slot, and protect control block with it
+/// 
+/// Note: each slot is tried once, so that reader never waits for other readers,
+/// and if all slots are taken, then reader takes reference instead.
+/// </summary>
+/// <param name="p_control_block">Control block to be protected</param>
+/// <returns>Index of the hazard slot, or -1 if all hazard slots are taken</returns>
+LONG ntarc_hazard_acquire(LONG64 p_control_block) {
+    LONG index;
+    LONG attempt;
+
+    index = (LONG)(NTARC_CURRENT_PROCESSOR() % NTARC_HAZARD_COUNT);
+
+    for (attempt = 0; attempt != NTARC_HAZARD_COUNT; ++attempt) {
+        if (0 == InterlockedCompareExchange64(&(g_ntarc_hazards[index].p_control_block), p_control_block, 0)) {
+            return index;
+        }
+
+        index = (index + 1) % NTARC_HAZARD_COUNT;
+    }
+
+    return -1;
+}
+
+/// <summary>
+/// Wait until no reader protects control block with hazard slot
+/// </summary>
+/// <param name="p_control_block">Control block that is going to be destroyed</param>
+void ntarc_hazard_wait(LONG64 p_control_block) {
+    LONG index;
+
+    NTARC_ASSERT_SPIN_IRQL();
+
+    for (index = 0; index != NTARC_HAZARD_COUNT; ++index) {
+        while (p_control_block == ReadAcquire64(&(g_ntarc_hazards[index].p_control_block))) {
+#ifdef NTARC_CHECK_HAZARD
+            // Calling thread still borrows control block it is destroying
+            NTARC_ASSERT(NTARC_CURRENT_THREAD() != ReadAcquire64(&(g_ntarc_hazards[index].owner_thread)));
+#endif
+            YieldProcessor();
+        }
+    }
+}
+
 /// <summary>
 /// Initialize ARC w/ Control Block
 /// </summary>
@@ -93,8 +419,68 @@ void ntarc_new_with_control_block(PVOID p_data, PNTARC_CONTROL_BLOCK p_control_b
 void ntarc_control_block_new(LONG reference_count, PVOID p_destroy_context, PFN_NTARC_DESTROY pfn_destroy,
     PNTARC_CONTROL_BLOCK p_result) {
     p_result->reference_count = reference_count;
+    p_result->store_version = 0;
+    p_result->weak_count = 1;
     p_result->p_destroy_context = p_destroy_context;
     p_result->pfn_destroy = pfn_destroy;
+    p_result->pfn_free = NULL;
+    p_result->p_reclaim = NULL;
+    p_result->p_retired_next = 0;
+    p_result->p_retired_data = 0;
+}
+
+/// <summary>
+/// Defer destruction of ARC to Reclaim Domain
+/// 
+/// Note: must be set before ARC is shared with other threads.
+/// </summary>
+/// <param name="p_control_block">A pointer to initialized ARC Control Block</param>
+/// <param name="p_reclaim">A pointer to Reclaim Domain, or NULL to destroy on last drop</param>
+void ntarc_control_block_set_reclaim(PNTARC_CONTROL_BLOCK p_control_block, PNTARC_RECLAIM p_reclaim) {
+    p_control_block->p_reclaim = p_reclaim;
+}
+
+/// <summary>
+/// Enable weak references to ARC
+/// 
+/// Note: must be set before ARC is shared with other threads. Destructor
+/// must then not free control block, as Free Function will do that.
+/// </summary>
+/// <param name="p_control_block">A pointer to initialized ARC Control Block</param>
+/// <param name="pfn_free">A pointer to user-defined Free Function, it receives same Destructor Context</param>
+void ntarc_control_block_set_free(PNTARC_CONTROL_BLOCK p_control_block, PFN_NTARC_FREE pfn_free) {
+    p_control_block->pfn_free = pfn_free;
+}
+
+/// <summary>
+/// Drop weak count of control block, and free it if that was last
+/// </summary>
+/// <param name="p_control_block">A pointer to ARC Control Block with Free Function</param>
+void ntarc_control_block_release(PNTARC_CONTROL_BLOCK p_control_block) {
+    if (0 == InterlockedDecrement(&(p_control_block->weak_count))) {
+        (*p_control_block->pfn_free)(&(p_control_block->p_destroy_context), p_control_block);
+    }
+}
+
+/// <summary>
+/// Destroy ARC that lost its last reference
+/// </summary>
+/// <param name="p_pointer">A pointer to variable holding ARC to be destroyed</param>
+void ntarc_destroy(PNTARC p_pointer) {
+    PNTARC_CONTROL_BLOCK p_control_block = NTARC_PCONTROL_BLOCK(p_pointer);
+    PFN_NTARC_FREE pfn_free = p_control_block->pfn_free;
+
+    // Reader may still be checking control block in its hazard slot, but only
+    // if ARC was stored, and then it was also removed, which changed store version
+    if (0 != ReadAcquire(NTARC_PSTORE_VERSION(p_pointer))) {
+        ntarc_hazard_wait(p_pointer->p_control_block);
+    }
+    (*NTARC_PFNDESTROY(p_pointer))(NTARC_PDESTROY_CONTEXT(p_pointer), p_pointer);
+
+    // Without Free Function destructor has freed control block
+    if (NULL != pfn_free) {
+        ntarc_control_block_release(p_control_block);
+    }
 }
 
 /// <summary>
@@ -111,6 +497,218 @@ void ntarc_new(PVOID p_data, PVOID p_destroy_context, PFN_NTARC_DESTROY pfn_dest
     ntarc_new_with_control_block(p_data, p_control_block, p_result);
 }
 
+/// <summary>
+/// Initialize ARC in single allocation
+/// 
+/// Note: allocation of NTARC_INLINE_SIZE(sizeof(USERTYPE), alignment) bytes holds
+/// control block followed by user-defined data at NTARC_INLINE_DATA_OFFSET(alignment).
+/// ARC still holds pointer to data, so NTARC_PDATA() does not need to compute it, and
+/// destructor needs to free only control block.
+/// </summary>
+/// <param name="p_allocation">A pointer to uninitialized user-allocated memory aligned to alignment</param>
+/// <param name="alignment">Alignment of user-defined data (power of 2)</param>
+/// <param name="p_destroy_context">A pointer to user-specified Destructor Context</param>
+/// <param name="pfn_destroy">A pointer to user-defined Destructor Function</param>
+/// <param name="p_result">A pointer to variable receiving the ARC</param>
+/// <returns>A pointer to uninitialized user-defined data</returns>
+PVOID ntarc_new_inline(PVOID p_allocation, SIZE_T alignment, PVOID p_destroy_context, PFN_NTARC_DESTROY pfn_destroy,
+    PNTARC p_result) {
+    PNTARC_CONTROL_BLOCK p_control_block = (PNTARC_CONTROL_BLOCK)p_allocation;
+    PVOID p_data = NTARC_INLINE_PDATA(p_control_block, alignment);
+
+    ntarc_new(p_data, p_destroy_context, pfn_destroy, p_control_block, p_result);
+
+    return p_data;
+}
+
+/// <summary>
+/// Return block to Pool
+/// </summary>
+/// <param name="p_pool">A pointer to Pool</param>
+/// <param name="p_block">A pointer to block allocated from the Pool</param>
+void ntarc_pool_free(PNTARC_POOL p_pool, PVOID p_block) {
+    LONG64 old_head[2];
+
+    do {
+        old_head[0] = p_pool->free_list[0];
+        old_head[1] = p_pool->free_list[1];
+        *(LONG64*)p_block = old_head[0];
+
+    } while (FALSE == InterlockedCompareExchange128(p_pool->free_list, old_head[1] + 1, (LONG64)p_block, old_head));
+}
+
+/// <summary>
+/// Allocate block from Pool
+/// </summary>
+/// <param name="p_pool">A pointer to Pool</param>
+/// <returns>A pointer to block, or NULL if Pool is exhausted</returns>
+PVOID ntarc_pool_alloc(PNTARC_POOL p_pool) {
+    LONG64 old_head[2];
+
+    do {
+        old_head[0] = p_pool->free_list[0];
+        old_head[1] = p_pool->free_list[1];
+
+        if (0 == old_head[0]) {
+            return NULL;
+        }
+
+        // Block stays in Pool memory, so it can be read even if it was popped
+        // meanwhile, and then tag tells CAS to fail
+    } while (FALSE == InterlockedCompareExchange128(p_pool->free_list, old_head[1] + 1, *(LONG64 volatile*)old_head[0], old_head));
+
+    return (PVOID)old_head[0];
+}
+
+/// <summary>
+/// Initialize Pool
+/// 
+/// Note: memory must be aligned to MEMORY_ALLOCATION_ALIGNMENT, and it must
+/// remain allocated until no thread uses the Pool.
+/// </summary>
+/// <param name="p_pool">A pointer to Pool</param>
+/// <param name="p_memory">A pointer to user-allocated memory for blocks</param>
+/// <param name="memory_size">Size of memory in bytes</param>
+/// <param name="block_size">Size of block in bytes, e.g. NTARC_INLINE_SIZE(sizeof(USERTYPE), alignment)</param>
+/// <returns>Count of blocks in Pool</returns>
+LONG ntarc_pool_init(PNTARC_POOL p_pool, PVOID p_memory, SIZE_T memory_size, SIZE_T block_size) {
+    SIZE_T offset;
+
+    block_size = (block_size + MEMORY_ALLOCATION_ALIGNMENT - 1) & ~((SIZE_T)MEMORY_ALLOCATION_ALIGNMENT - 1);
+
+    p_pool->free_list[0] = 0;
+    p_pool->free_list[1] = 0;
+    p_pool->block_size = block_size;
+    p_pool->block_count = 0;
+
+    for (offset = 0; offset + block_size <= memory_size; offset += block_size) {
+        ntarc_pool_free(p_pool, (PUCHAR)p_memory + offset);
+        ++p_pool->block_count;
+    }
+
+    return p_pool->block_count;
+}
+
+/// <summary>
+/// Destructor Function returning single allocation of ARC to Pool
+/// 
+/// Note: use Pool as Destructor Context. User-defined data is not destructed.
+/// </summary>
+/// <param name="p_context">A pointer to Destructor Context holding pointer to Pool</param>
+/// <param name="p_arc">A pointer to variable storing ARC that is to be destroyed</param>
+void ntarc_pool_destroy(PVOID p_context, PNTARC p_arc) {
+    if (0 == p_arc->p_data) {
+        return;
+    }
+
+    ntarc_pool_free(*(PNTARC_POOL*)p_context, (PVOID)p_arc->p_control_block);
+
+    p_arc->p_data = 0;
+    p_arc->p_control_block = 0;
+}
+
+/// <summary>
+/// Initialize ARC in single allocation from Pool
+/// </summary>
+/// <param name="p_pool">A pointer to Pool with blocks of at least NTARC_INLINE_SIZE(data_size, alignment) bytes</param>
+/// <param name="alignment">Alignment of user-defined data (power of 2, at most MEMORY_ALLOCATION_ALIGNMENT)</param>
+/// <param name="p_result">A pointer to variable receiving the ARC</param>
+/// <returns>A pointer to uninitialized user-defined data, or NULL if Pool is exhausted</returns>
+PVOID ntarc_pool_new(PNTARC_POOL p_pool, SIZE_T alignment, PNTARC p_result) {
+    PVOID p_allocation = ntarc_pool_alloc(p_pool);
+
+    if (NULL == p_allocation) {
+        p_result->p_control_block = 0;
+        p_result->p_data = 0;
+        return NULL;
+    }
+
+    return ntarc_new_inline(p_allocation, alignment, p_pool, &ntarc_pool_destroy, p_result);
+}
+
+#ifdef _KERNEL_MODE
+/// <summary>
+/// Destructor Function returning single allocation of ARC to Lookaside List
+/// 
+/// Note: use LOOKASIDE_LIST_EX as Destructor Context, and allocate with
+/// ExAllocateFromLookasideListEx(). User-defined data is not destructed.
+/// </summary>
+/// <param name="p_context">A pointer to Destructor Context holding pointer to Lookaside List</param>
+/// <param name="p_arc">A pointer to variable storing ARC that is to be destroyed</param>
+void ntarc_lookaside_destroy(PVOID p_context, PNTARC p_arc) {
+    if (0 == p_arc->p_data) {
+        return;
+    }
+
+    ExFreeToLookasideListEx(*(PLOOKASIDE_LIST_EX*)p_context, (PVOID)p_arc->p_control_block);
+
+    p_arc->p_data = 0;
+    p_arc->p_control_block = 0;
+}
+#endif
+
+/// <summary>
+/// Initialize Reclaim Domain
+/// </summary>
+/// <param name="p_reclaim">A pointer to Reclaim Domain</param>
+void ntarc_reclaim_init(PNTARC_RECLAIM p_reclaim) {
+    p_reclaim->p_retired = 0;
+    p_reclaim->retired_count = 0;
+}
+
+/// <summary>
+/// Put ARC that lost its last reference onto retired list
+/// </summary>
+/// <param name="p_pointer">A pointer to variable holding ARC to be retired</param>
+void ntarc_retire(PNTARC p_pointer) {
+    PNTARC_CONTROL_BLOCK p_control_block = NTARC_PCONTROL_BLOCK(p_pointer);
+    PNTARC_RECLAIM p_reclaim = p_control_block->p_reclaim;
+    LONG64 p_retired;
+
+    p_control_block->p_retired_data = p_pointer->p_data;
+
+    // Retired list is only pushed to and taken whole, so there is no ABA
+    do {
+        p_retired = p_reclaim->p_retired;
+        p_control_block->p_retired_next = p_retired;
+
+    } while (p_retired != InterlockedCompareExchange64(&(p_reclaim->p_retired), p_pointer->p_control_block, p_retired));
+
+    InterlockedIncrement(&(p_reclaim->retired_count));
+}
+
+/// <summary>
+/// Run destructors of all ARCs retired to Reclaim Domain
+/// 
+/// Note: Destructors may drop other ARCs of the same domain,
+/// and those will be destroyed by next call.
+/// </summary>
+/// <param name="p_reclaim">A pointer to Reclaim Domain</param>
+/// <returns>Count of destroyed ARCs</returns>
+LONG ntarc_reclaim(PNTARC_RECLAIM p_reclaim) {
+    NTARC retired;
+    LONG64 p_next;
+    LONG count = 0;
+
+    retired.p_control_block = InterlockedExchange64(&(p_reclaim->p_retired), 0);
+
+    while (0 != retired.p_control_block) {
+        p_next = NTARC_PCONTROL_BLOCK((&retired))->p_retired_next;
+        retired.p_data = NTARC_PCONTROL_BLOCK((&retired))->p_retired_data;
+
+        ntarc_destroy(&retired);
+
+        retired.p_control_block = p_next;
+        ++count;
+    }
+
+    if (0 != count) {
+        InterlockedExchangeAdd(&(p_reclaim->retired_count), -count);
+    }
+
+    return count;
+}
+
 /// <summary>
 /// Clone ARC
 /// </summary>
@@ -136,7 +734,12 @@ LONG ntarc_drop_reference(PNTARC p_pointer) {
 
 void ntarc_drop_data(PNTARC p_pointer, LONG reference_count) {
     if (1 == reference_count) {
-        (*NTARC_PFNDESTROY(p_pointer))(NTARC_PDESTROY_CONTEXT(p_pointer), p_pointer);
+        if (NULL != NTARC_PCONTROL_BLOCK(p_pointer)->p_reclaim) {
+            ntarc_retire(p_pointer);
+            return;
+        }
+
+        ntarc_destroy(p_pointer);
     }
 }
 
@@ -155,23 +758,160 @@ LONG ntarc_drop(PNTARC p_pointer) {
 }
 
 /// <summary>
-/// Tell if two ARCs are the same, i.e. pointing to same data
+/// Clone ARC unless it lost its last reference
+/// 
+/// Note: use this to clone ARC without reference, e.g. borrowed ARC.
+/// Reference count is incremented only if it is not zero, i.e. object
+/// is not being destroyed.
 /// </summary>
-BOOLEAN ntarc_is_equal(PNTARC p_first, PNTARC p_second) {
-    return (p_first->p_control_block == p_second->p_control_block);
+/// <param name="p_pointer">A pointer to variable holding an ARC to be cloned</param>
+/// <param name="p_result">A pointer to variable receiving the cloned ARC</param>
+/// <returns>TRUE if ARC was cloned, FALSE if object is being destroyed</returns>
+BOOLEAN ntarc_try_clone(PNTARC p_pointer, PNTARC p_result) {
+    LONG reference_count;
+    LONG old_reference_count;
+
+    if (0 != p_pointer->p_data) {
+        reference_count = *NTARC_PREFCOUNT(p_pointer);
+
+        do {
+            if (0 == reference_count) {
+                return FALSE;
+            }
+
+            old_reference_count = reference_count;
+            reference_count = InterlockedCompareExchange(NTARC_PREFCOUNT(p_pointer), old_reference_count + 1, old_reference_count);
+
+        } while (reference_count != old_reference_count);
+    }
+
+    p_result->p_control_block = p_pointer->p_control_block;
+    p_result->p_data = p_pointer->p_data;
+
+    return TRUE;
 }
 
-void ntarc_exchange(NTARC volatile* p_store, PNTARC p_pointer, PNTARC p_result) {
-    NTARC old_chunk;
+/// <summary>
+/// Clone ARC many times in single interlocked operation
+/// 
+/// Note: ARC must hold reference, i.e. it must not be borrowed.
+/// </summary>
+/// <param name="p_pointer">A pointer to variable holding an ARC to be cloned</param>
+/// <param name="count">Count of clones</param>
+/// <param name="p_results">A pointer to array of count variables receiving the cloned ARC</param>
+void ntarc_clone_n(PNTARC p_pointer, LONG count, PNTARC p_results) {
+    LONG index;
 
-    do {
-        old_chunk.p_control_block = p_store->p_control_block;
-        old_chunk.p_data = p_store->p_data;
+    if (0 != p_pointer->p_data && 0 < count) {
+        InterlockedExchangeAdd(NTARC_PREFCOUNT(p_pointer), count);
+    }
 
-    } while (FALSE == NTARC_COMPARE_EXCHANGE(p_store, (*p_pointer), old_chunk));
-    
-    p_result->p_control_block = old_chunk.p_control_block;
-    p_result->p_data = old_chunk.p_data;
+    for (index = 0; index != count; ++index) {
+        p_results[index].p_control_block = p_pointer->p_control_block;
+        p_results[index].p_data = p_pointer->p_data;
+    }
+}
+
+/// <summary>
+/// Drop many references of ARC in single interlocked operation
+/// </summary>
+/// <param name="p_pointer">A pointer to variable holding one of the references to be dropped</param>
+/// <param name="count">Count of references to be dropped</param>
+/// <returns>Reference count before drop happened</returns>
+LONG ntarc_drop_n(PNTARC p_pointer, LONG count) {
+    LONG ref_count;
+
+    if (0 == p_pointer->p_data || 0 >= count) {
+        return 0;
+    }
+
+    ref_count = InterlockedExchangeAdd(NTARC_PREFCOUNT(p_pointer), -count);
+    ntarc_drop_data(p_pointer, ref_count - count + 1);
+
+    return ref_count;
+}
+
+/// <summary>
+/// Clone weak reference from ARC
+/// 
+/// Note: ARC must have Free Function set by ntarc_control_block_set_free().
+/// </summary>
+/// <param name="p_pointer">A pointer to variable holding an ARC</param>
+/// <param name="p_result">A pointer to variable receiving weak reference</param>
+void ntarc_weak_clone(PNTARC p_pointer, PNTARC_WEAK p_result) {
+    if (0 != p_pointer->p_data) {
+        InterlockedIncrement(NTARC_PWEAKCOUNT(p_pointer));
+    }
+
+    p_result->p_control_block = p_pointer->p_control_block;
+    p_result->p_data = p_pointer->p_data;
+}
+
+/// <summary>
+/// Copy weak reference
+/// </summary>
+/// <param name="p_weak">A pointer to variable holding weak reference to be copied</param>
+/// <param name="p_result">A pointer to variable receiving copy of weak reference</param>
+void ntarc_weak_copy(PNTARC_WEAK p_weak, PNTARC_WEAK p_result) {
+    if (0 != p_weak->p_data) {
+        InterlockedIncrement(NTARC_PWEAKCOUNT(p_weak));
+    }
+
+    p_result->p_control_block = p_weak->p_control_block;
+    p_result->p_data = p_weak->p_data;
+}
+
+/// <summary>
+/// Upgrade weak reference to ARC
+/// 
+/// Note: reference count is incremented only if object was not destroyed.
+/// </summary>
+/// <param name="p_weak">A pointer to variable holding weak reference</param>
+/// <param name="p_result">A pointer to variable receiving ARC, or NTARC{0,0} if object was destroyed</param>
+/// <returns>TRUE if object is still alive, FALSE otherwise</returns>
+BOOLEAN ntarc_weak_upgrade(PNTARC_WEAK p_weak, PNTARC p_result) {
+    LONG reference_count;
+
+    p_result->p_control_block = 0;
+    p_result->p_data = 0;
+
+    if (0 == p_weak->p_data) {
+        return FALSE;
+    }
+
+    reference_count = *NTARC_PREFCOUNT(p_weak);
+
+    while (0 != reference_count) {
+        if (reference_count == InterlockedCompareExchange(NTARC_PREFCOUNT(p_weak), reference_count + 1, reference_count)) {
+            p_result->p_control_block = p_weak->p_control_block;
+            p_result->p_data = p_weak->p_data;
+            return TRUE;
+        }
+
+        reference_count = *NTARC_PREFCOUNT(p_weak);
+    }
+
+    return FALSE;
+}
+
+/// <summary>
+/// Drop weak reference
+/// </summary>
+/// <param name="p_weak">A pointer to variable holding weak reference to be dropped</param>
+void ntarc_weak_drop(PNTARC_WEAK p_weak) {
+    if (0 != p_weak->p_data) {
+        ntarc_control_block_release(NTARC_PCONTROL_BLOCK(p_weak));
+    }
+
+    p_weak->p_control_block = 0;
+    p_weak->p_data = 0;
+}
+
+/// <summary>
+/// Tell if two ARCs are the same, i.e. pointing to same data
+/// </summary>
+BOOLEAN ntarc_is_equal(PNTARC p_first, PNTARC p_second) {
+    return (p_first->p_control_block == p_second->p_control_block);
 }
 
 void ntarc_atomic_begin(NTARC volatile* p_store, PNTARC p_old) {
@@ -180,6 +920,10 @@ void ntarc_atomic_begin(NTARC volatile* p_store, PNTARC p_old) {
     do {
         old_chunk.p_control_block = p_store->p_control_block;
         old_chunk.p_data = p_store->p_data;
+
+        // Locked store keeps data of old ARC, so that reader, which has seen old
+        // control block before store was locked, cannot read data torn by the lock
+        special_chunk.p_data = old_chunk.p_data;
         
     } while (ntarc_is_equal(&old_chunk, &special_chunk) 
         || (FALSE == NTARC_COMPARE_EXCHANGE(p_store, special_chunk, old_chunk)));
@@ -190,9 +934,30 @@ void ntarc_atomic_begin(NTARC volatile* p_store, PNTARC p_old) {
 
 BOOLEAN ntarc_atomic_commit(NTARC volatile *p_store, PNTARC p_pointer) {
     NTARC special_chunk = {1,0};
+
+    // Store is locked by this thread, so it still holds data of old ARC
+    special_chunk.p_data = p_store->p_data;
     return NTARC_COMPARE_EXCHANGE(p_store, (*p_pointer), special_chunk);
 }
 
+void ntarc_atomic_removed(PNTARC p_old) {
+    // Old ARC must be marked as removed before new ARC becomes visible
+    if (0 != p_old->p_data) {
+        InterlockedIncrement(NTARC_PSTORE_VERSION(p_old));
+    }
+}
+
+void ntarc_exchange(NTARC volatile* p_store, PNTARC p_pointer, PNTARC p_result) {
+    NTARC old_chunk;
+
+    ntarc_atomic_begin(p_store, &old_chunk);
+    ntarc_atomic_removed(&old_chunk);
+    ntarc_atomic_commit(p_store, p_pointer);
+
+    p_result->p_control_block = old_chunk.p_control_block;
+    p_result->p_data = old_chunk.p_data;
+}
+
 /// <summary>
 /// Atomic Store
 /// </summary>
@@ -204,20 +969,503 @@ void ntarc_atomic_store(NTARC volatile *p_store, PNTARC p_pointer) {
     LONG old_reference_count;
     ntarc_clone(p_pointer, &new_chunk);
     ntarc_atomic_begin(p_store, &old_chunk);
+    ntarc_atomic_removed(&old_chunk);
     old_reference_count = ntarc_drop_reference(&old_chunk);
     ntarc_atomic_commit(p_store, &new_chunk);
     ntarc_drop_data(&old_chunk, old_reference_count);
 }
 
+/// <summary>
+/// Release hazard slot
+/// </summary>
+/// <param name="p_hazard_index">A pointer to variable holding index of the hazard slot, or -1</param>
+void ntarc_atomic_unprotect(PLONG p_hazard_index) {
+    if (-1 != *p_hazard_index) {
+#ifdef NTARC_CHECK_HAZARD
+        WriteRelease64(&(g_ntarc_hazards[*p_hazard_index].owner_thread), 0);
+#endif
+        InterlockedExchange64(&(g_ntarc_hazards[*p_hazard_index].p_control_block), 0);
+        *p_hazard_index = -1;
+    }
+}
+
+/// <summary>
+/// Read shared ARC, and protect its control block with hazard slot
+/// 
+/// Note: this does not write to the shared variable, so readers don't
+/// serialize with each other. Reader protects control block with hazard
+/// slot, and reads shared ARC between two reads of store version. If
+/// version did not change, and control block is still stored, then data
+/// belongs to the control block, and it will not be destroyed until
+/// hazard slot is released. Writer that locks the store without removing
+/// the ARC, e.g. to clone it, leaves its data in the store, so that data
+/// read while the store is locked still belongs to the control block.
+/// </summary>
+/// <param name="p_store">A pointer to global variable holding shared ARC</param>
+/// <param name="p_hazard_index">A pointer to variable holding index of the hazard slot, or -1 to acquire one</param>
+/// <param name="p_result">A pointer to variable receiving the shared ARC (without reference)</param>
+/// <returns>TRUE if shared ARC was read, FALSE if all hazard slots are taken</returns>
+BOOLEAN ntarc_atomic_protect(NTARC volatile *p_store, PLONG p_hazard_index, PNTARC p_result) {
+    NTARC old_chunk;
+    LONG store_version;
+
+    NTARC_ASSERT_SPIN_IRQL();
+
+    for (;;) {
+        old_chunk.p_control_block = ReadAcquire64(&(p_store->p_control_block));
+
+        if (0 == old_chunk.p_control_block) {
+            old_chunk.p_data = 0;
+
+            // Do not keep protecting control block loaded by previous iteration
+            ntarc_atomic_unprotect(p_hazard_index);
+            break;
+        }
+
+        // Store is being changed by writer
+        if (1 == old_chunk.p_control_block) {
+            YieldProcessor();
+            continue;
+        }
+
+        if (-1 == *p_hazard_index) {
+            *p_hazard_index = ntarc_hazard_acquire(old_chunk.p_control_block);
+
+            if (-1 == *p_hazard_index) {
+                p_result->p_control_block = 0;
+                p_result->p_data = 0;
+                return FALSE;
+            }
+
+#ifdef NTARC_CHECK_HAZARD
+            WriteRelease64(&(g_ntarc_hazards[*p_hazard_index].owner_thread), NTARC_CURRENT_THREAD());
+#endif
+        }
+        else {
+            InterlockedExchange64(&(g_ntarc_hazards[*p_hazard_index].p_control_block), old_chunk.p_control_block);
+        }
+
+        // Control block is protected only if it is still stored after hazard slot was set
+        if (old_chunk.p_control_block != ReadAcquire64(&(p_store->p_control_block))) {
+            continue;
+        }
+
+        store_version = ReadAcquire(NTARC_PSTORE_VERSION((&old_chunk)));
+
+        if (old_chunk.p_control_block != ReadAcquire64(&(p_store->p_control_block))) {
+            continue;
+        }
+
+        old_chunk.p_data = ReadAcquire64(&(p_store->p_data));
+
+        if (store_version == ReadAcquire(NTARC_PSTORE_VERSION((&old_chunk)))) {
+            break;
+        }
+    }
+
+    p_result->p_control_block = old_chunk.p_control_block;
+    p_result->p_data = old_chunk.p_data;
+    return TRUE;
+}
+
+/// <summary>
+/// Clone shared ARC while holding shared variable
+/// 
+/// Note: this writes to the shared variable, so that readers serialize with
+/// each other and with writers. Atomic Load and Borrow use it only when all
+/// hazard slots are taken.
+/// </summary>
+/// <param name="p_store">A pointer to global variable holding shared ARC</param>
+/// <param name="p_result">A pointer to variable receiving clone of the shared ARC</param>
+void ntarc_atomic_clone(NTARC volatile *p_store, PNTARC p_result) {
+    NTARC old_chunk;
+
+    ntarc_atomic_begin(p_store, &old_chunk);
+    ntarc_clone(&old_chunk, p_result);
+    ntarc_atomic_commit(p_store, &old_chunk);
+}
+
 /// <summary>
 /// Atomic Load
+/// 
+/// Note: this does not write to the shared variable, unless all hazard slots
+/// are taken. Reference count is incremented only if it is not zero, i.e.
+/// object is not being destroyed.
 /// </summary>
 /// <param name="p_store">A pointer to global variable holding shared ARC</param>
 /// <param name="p_pointer">A pointer to variable receiving clone of the shared ARC</param>
 void ntarc_atomic_load(NTARC volatile *p_store, PNTARC p_result) {
     NTARC old_chunk;
+    LONG hazard_index = -1;
+
+    do {
+        if (FALSE == ntarc_atomic_protect(p_store, &hazard_index, &old_chunk)) {
+            ntarc_atomic_clone(p_store, p_result);
+            return;
+        }
+
+    } while (FALSE == ntarc_try_clone(&old_chunk, p_result));
+
+    ntarc_atomic_unprotect(&hazard_index);
+}
+
+/// <summary>
+/// Borrow shared ARC without taking reference
+/// 
+/// Note: borrowed ARC is protected by hazard slot, and it must be returned with
+/// ntarc_borrow_end(), and it must not be dropped nor cloned other than with
+/// ntarc_try_clone(). Keep the scope short, as last drop of the object waits until
+/// it is returned. Thread must not store to, or drop last reference of, the object
+/// it has borrowed, as it would wait for itself (with NTARC_CHECK_HAZARD, which
+/// is defined in debug builds, this asserts instead).
+/// 
+/// Borrow writes only the hazard slot it takes, starting from slot of current CPU:
+/// one compare-exchange to take it, and one exchange in ntarc_borrow_end() to
+/// release it. No other shared memory is written, unless all slots are taken and
+/// borrow falls back to clone.
+/// </summary>
+/// <param name="p_store">A pointer to global variable holding shared ARC</param>
+/// <param name="p_borrow">A pointer to variable receiving borrowed ARC</param>
+/// <returns>A pointer to user-defined data, or NULL if shared ARC is NTARC{0,0}</returns>
+PVOID ntarc_borrow_begin(NTARC volatile *p_store, PNTARC_BORROW p_borrow) {
+    p_borrow->hazard_index = -1;
+
+    if (FALSE == ntarc_atomic_protect(p_store, &(p_borrow->hazard_index), &(p_borrow->arc))) {
+        ntarc_atomic_clone(p_store, &(p_borrow->arc));
+        p_borrow->hazard_index = NTARC_BORROW_REFERENCE;
+    }
+
+    return (PVOID)p_borrow->arc.p_data;
+}
+
+/// <summary>
+/// Return borrowed ARC
+/// </summary>
+/// <param name="p_borrow">A pointer to variable holding borrowed ARC</param>
+void ntarc_borrow_end(PNTARC_BORROW p_borrow) {
+    if (NTARC_BORROW_REFERENCE == p_borrow->hazard_index) {
+        ntarc_drop(&(p_borrow->arc));
+        p_borrow->hazard_index = -1;
+    }
+
+    ntarc_atomic_unprotect(&(p_borrow->hazard_index));
+
+    p_borrow->arc.p_control_block = 0;
+    p_borrow->arc.p_data = 0;
+}
+
+/// <summary>
+/// Atomic Compare Exchange
+/// 
+/// Note: if shared variable holds expected ARC, then it is replaced with clone of
+/// desired ARC, and shared reference to expected ARC is dropped. Otherwise expected
+/// ARC is dropped, and replaced with clone of ARC that shared variable holds.
+/// </summary>
+/// <param name="p_store">A pointer to global variable holding shared ARC</param>
+/// <param name="p_expected">A pointer to variable holding expected ARC, receiving current ARC on failure</param>
+/// <param name="p_desired">A pointer to variable holding ARC to be stored</param>
+/// <returns>TRUE if desired ARC was stored, FALSE otherwise</returns>
+BOOLEAN ntarc_atomic_compare_exchange(NTARC volatile *p_store, PNTARC p_expected, PNTARC p_desired) {
+    NTARC old_chunk;
+    NTARC new_chunk;
+    LONG64 p_control_block;
+    LONG old_reference_count;
+
+    // Don't write to shared variable if it does not hold expected ARC
+    p_control_block = ReadAcquire64(&(p_store->p_control_block));
+
+    if (1 != p_control_block && p_expected->p_control_block != p_control_block) {
+        ntarc_drop(p_expected);
+        ntarc_atomic_load(p_store, p_expected);
+        return FALSE;
+    }
+
     ntarc_atomic_begin(p_store, &old_chunk);
-    ntarc_clone(&old_chunk, p_result);
-    ntarc_atomic_commit(p_store, &old_chunk);
+
+    if (FALSE == ntarc_is_equal(&old_chunk, p_expected)) {
+        // Shared variable holds reference, so it is safe to clone
+        ntarc_clone(&old_chunk, &new_chunk);
+        ntarc_atomic_commit(p_store, &old_chunk);
+        ntarc_drop(p_expected);
+
+        p_expected->p_control_block = new_chunk.p_control_block;
+        p_expected->p_data = new_chunk.p_data;
+        return FALSE;
+    }
+
+    ntarc_clone(p_desired, &new_chunk);
+    ntarc_atomic_removed(&old_chunk);
+    old_reference_count = ntarc_drop_reference(&old_chunk);
+    ntarc_atomic_commit(p_store, &new_chunk);
+    ntarc_drop_data(&old_chunk, old_reference_count);
+
+    return TRUE;
+}
+
+/// <summary>
+/// Atomic Update
+/// 
+/// Note: Update Function creates new ARC from current ARC, e.g. copy of routing table
+/// with a change, and it is called again with newer current ARC if another writer
+/// stored in the meantime. Update Function must not store to the shared variable.
+/// </summary>
+/// <param name="p_store">A pointer to global variable holding shared ARC</param>
+/// <param name="pfn_update">A pointer to user-defined Update Function</param>
+/// <param name="p_context">A pointer to user-specified Update Context</param>
+/// <returns>TRUE if new ARC was stored, FALSE if Update Function cancelled update</returns>
+BOOLEAN ntarc_atomic_update(NTARC volatile *p_store, PFN_NTARC_UPDATE pfn_update, PVOID p_context) {
+    NTARC current;
+    NTARC desired;
+    BOOLEAN is_stored;
+
+    ntarc_atomic_load(p_store, &current);
+
+    for (;;) {
+        if (FALSE == (*pfn_update)(p_context, &current, &desired)) {
+            is_stored = FALSE;
+            break;
+        }
+
+        is_stored = ntarc_atomic_compare_exchange(p_store, &current, &desired);
+        ntarc_drop(&desired);
+
+        if (FALSE != is_stored) {
+            break;
+        }
+    }
+
+    ntarc_drop(&current);
+
+    return is_stored;
+}
+
+/// <summary>
+/// Atomic Store to Versioned ARC
+/// </summary>
+/// <param name="p_versioned">A pointer to global variable holding Versioned ARC</param>
+/// <param name="p_pointer">A pointer to variable holding ARC to be stored</param>
+void ntarc_versioned_store(NTARC_VERSIONED volatile *p_versioned, PNTARC p_pointer) {
+    ntarc_atomic_store(&(p_versioned->arc), p_pointer);
+
+    // Generation changes after new ARC is visible, so that reader who sees
+    // new generation also loads new ARC
+    InterlockedIncrement64(&(p_versioned->generation));
+}
+
+/// <summary>
+/// Initialize Cached ARC
+/// </summary>
+/// <param name="p_cache">A pointer to thread-local Cached ARC</param>
+void ntarc_cache_init(PNTARC_CACHE p_cache) {
+    p_cache->arc.p_control_block = 0;
+    p_cache->arc.p_data = 0;
+    p_cache->generation = -1;
+}
+
+/// <summary>
+/// Load Versioned ARC through Cached ARC
+/// 
+/// Note: if generation did not change since last call, this only reads the
+/// generation. Otherwise it drops cached clone, and loads new one. Cached
+/// clone keeps the object alive until next call that reloads it, or until
+/// ntarc_cache_drop().
+/// </summary>
+/// <param name="p_versioned">A pointer to global variable holding Versioned ARC</param>
+/// <param name="p_cache">A pointer to thread-local Cached ARC</param>
+/// <returns>A pointer to user-defined data, or NULL if Versioned ARC is NTARC{0,0}</returns>
+PVOID ntarc_cached_load(NTARC_VERSIONED volatile *p_versioned, PNTARC_CACHE p_cache) {
+    LONG64 generation = ReadAcquire64(&(p_versioned->generation));
+
+    if (generation != p_cache->generation) {
+        ntarc_drop(&(p_cache->arc));
+        ntarc_atomic_load(&(p_versioned->arc), &(p_cache->arc));
+        p_cache->generation = generation;
+    }
+
+    return (PVOID)p_cache->arc.p_data;
+}
+
+/// <summary>
+/// Drop Cached ARC
+/// </summary>
+/// <param name="p_cache">A pointer to thread-local Cached ARC</param>
+void ntarc_cache_drop(PNTARC_CACHE p_cache) {
+    ntarc_drop(&(p_cache->arc));
+    ntarc_cache_init(p_cache);
+}
+
+/// <summary>
+/// Initialize Node, and move ARC into it
+/// </summary>
+/// <param name="p_node">A pointer to Node</param>
+/// <param name="p_pointer">A pointer to variable holding ARC, which is set to NTARC{0,0}</param>
+void ntarc_node_init(PNTARC_NODE p_node, PNTARC p_pointer) {
+    p_node->p_next = 0;
+    p_node->arc = *p_pointer;
+
+    p_pointer->p_control_block = 0;
+    p_pointer->p_data = 0;
+}
+
+/// <summary>
+/// Move ARC out of Node
+/// </summary>
+/// <param name="p_node">A pointer to Node, which is no longer linked</param>
+/// <param name="p_result">A pointer to variable receiving the ARC</param>
+void ntarc_node_take(PNTARC_NODE p_node, PNTARC p_result) {
+    *p_result = p_node->arc;
+
+    p_node->arc.p_control_block = 0;
+    p_node->arc.p_data = 0;
+}
+
+/// <summary>
+/// Initialize Queue
+/// </summary>
+/// <param name="p_queue">A pointer to Queue</param>
+void ntarc_queue_init(PNTARC_QUEUE p_queue) {
+    p_queue->stub.p_next = 0;
+    p_queue->stub.arc.p_control_block = 0;
+    p_queue->stub.arc.p_data = 0;
+    p_queue->p_head = (LONG64)&(p_queue->stub);
+    p_queue->p_tail = (LONG64)&(p_queue->stub);
+}
+
+/// <summary>
+/// Push Node to Queue (any thread)
+/// 
+/// Note: this is single interlocked exchange, which never fails, and then
+/// release store linking previous head to the Node.
+/// </summary>
+/// <param name="p_queue">A pointer to Queue</param>
+/// <param name="p_node">A pointer to Node, which must not be linked</param>
+void ntarc_queue_push(PNTARC_QUEUE p_queue, PNTARC_NODE p_node) {
+    PNTARC_NODE p_prev;
+
+    p_node->p_next = 0;
+    p_prev = (PNTARC_NODE)InterlockedExchange64(&(p_queue->p_head), (LONG64)p_node);
+
+    // Until this store consumer cannot reach the Node, nor any Node pushed after it
+    WriteRelease64(&(p_prev->p_next), (LONG64)p_node);
+}
+
+/// <summary>
+/// Pop Node from Queue (consumer only)
+/// 
+/// Note: Queue may appear empty while producer is between exchange and link,
+/// i.e. NULL only tells to try again later. Nodes are popped in the order of
+/// their exchange, and popped Node belongs to the consumer.
+/// </summary>
+/// <param name="p_queue">A pointer to Queue</param>
+/// <returns>A pointer to Node, or NULL if no Node is ready</returns>
+PNTARC_NODE ntarc_queue_pop(PNTARC_QUEUE p_queue) {
+    PNTARC_NODE p_stub = &(p_queue->stub);
+    PNTARC_NODE p_tail = (PNTARC_NODE)p_queue->p_tail;
+    PNTARC_NODE p_next = (PNTARC_NODE)ReadAcquire64(&(p_tail->p_next));
+
+    if (p_stub == p_tail) {
+        if (NULL == p_next) {
+            return NULL;
+        }
+
+        p_queue->p_tail = (LONG64)p_next;
+        p_tail = p_next;
+        p_next = (PNTARC_NODE)ReadAcquire64(&(p_tail->p_next));
+    }
+
+    if (NULL != p_next) {
+        p_queue->p_tail = (LONG64)p_next;
+        return p_tail;
+    }
+
+    // Tail is the last Node, and it can be popped only once other Node follows it
+    if ((LONG64)p_tail != ReadAcquire64(&(p_queue->p_head))) {
+        return NULL;
+    }
+
+    ntarc_queue_push(p_queue, p_stub);
+    p_next = (PNTARC_NODE)ReadAcquire64(&(p_tail->p_next));
+
+    if (NULL != p_next) {
+        p_queue->p_tail = (LONG64)p_next;
+        return p_tail;
+    }
+
+    return NULL;
+}
+
+/// <summary>
+/// Initialize Stack
+/// </summary>
+/// <param name="p_stack">A pointer to Stack</param>
+void ntarc_stack_init(PNTARC_STACK p_stack) {
+    p_stack->top[0] = 0;
+    p_stack->top[1] = 0;
+}
+
+/// <summary>
+/// Push Node to Stack (any thread)
+/// </summary>
+/// <param name="p_stack">A pointer to Stack</param>
+/// <param name="p_node">A pointer to Node, which must not be linked</param>
+void ntarc_stack_push(PNTARC_STACK p_stack, PNTARC_NODE p_node) {
+    LONG64 old_top[2];
+
+    do {
+        old_top[0] = p_stack->top[0];
+        old_top[1] = p_stack->top[1];
+        p_node->p_next = old_top[0];
+
+    } while (FALSE == InterlockedCompareExchange128(p_stack->top, old_top[1] + 1, (LONG64)p_node, old_top));
+}
+
+/// <summary>
+/// Pop Node from Stack (any thread)
+/// 
+/// Note: Node may be read after other thread popped it, and then tag tells CAS
+/// to fail. Nodes must therefore stay in valid memory while Stack is used, e.g.
+/// allocated from Pool, or embedded in objects that are destroyed only once no
+/// thread can pop.
+/// </summary>
+/// <param name="p_stack">A pointer to Stack</param>
+/// <returns>A pointer to Node, or NULL if Stack is empty</returns>
+PNTARC_NODE ntarc_stack_pop(PNTARC_STACK p_stack) {
+    LONG64 old_top[2];
+
+    do {
+        old_top[0] = p_stack->top[0];
+        old_top[1] = p_stack->top[1];
+
+        if (0 == old_top[0]) {
+            return NULL;
+        }
+
+    } while (FALSE == InterlockedCompareExchange128(p_stack->top, old_top[1] + 1, ((PNTARC_NODE)old_top[0])->p_next, old_top));
+
+    return (PNTARC_NODE)old_top[0];
+}
+
+/// <summary>
+/// Pop all Nodes from Stack (any thread)
+/// 
+/// Note: Nodes are linked by p_next in LIFO order, and they are not read, so
+/// this has no requirement on memory of Nodes.
+/// </summary>
+/// <param name="p_stack">A pointer to Stack</param>
+/// <returns>A pointer to first Node, or NULL if Stack is empty</returns>
+PNTARC_NODE ntarc_stack_pop_all(PNTARC_STACK p_stack) {
+    LONG64 old_top[2];
+
+    do {
+        old_top[0] = p_stack->top[0];
+        old_top[1] = p_stack->top[1];
+
+        if (0 == old_top[0]) {
+            return NULL;
+        }
+
+    } while (FALSE == InterlockedCompareExchange128(p_stack->top, old_top[1] + 1, 0, old_top));
+
+    return (PNTARC_NODE)old_top[0];
 }
 